@@ -0,0 +1,434 @@
+/*
+  ==============================================================================
+
+    ConvolutionReverb.cpp
+
+  ==============================================================================
+*/
+
+#include "ConvolutionReverb.h"
+
+//==============================================================================
+ConvolutionReverb::FFT::FFT (int fftSizeToUse) : size (fftSizeToUse) {
+    jassert (isPowerOfTwo (size));
+
+    for (int i = 0; i < size / 2; ++i) {
+        twiddles.push_back (std::polar (1.0f, -MathConstants<float>::twoPi * (float) i / (float) size));
+    }
+
+    int numBits = 0;
+    while ((1 << numBits) < size) {
+        ++numBits;
+    }
+
+    for (int i = 0; i < size; ++i) {
+        int reversed = 0;
+
+        for (int bit = 0; bit < numBits; ++bit) {
+            reversed |= ((i >> bit) & 1) << (numBits - 1 - bit);
+        }
+
+        bitReversed.push_back (reversed);
+    }
+}
+
+void ConvolutionReverb::FFT::perform (Complex* data, bool inverse) const noexcept {
+    for (int i = 0; i < size; ++i) {
+        if (i < bitReversed[(size_t) i]) {
+            std::swap (data[i], data[bitReversed[(size_t) i]]);
+        }
+    }
+
+    for (int length = 2; length <= size; length <<= 1) {
+        auto half = length / 2;
+        auto step = size / length;
+
+        for (int start = 0; start < size; start += length) {
+            for (int k = 0; k < half; ++k) {
+                auto w = twiddles[(size_t) (k * step)];
+                auto u = data[start + k];
+                auto v = data[start + k + half] * (inverse ? std::conj (w) : w);
+                data[start + k] = u + v;
+                data[start + k + half] = u - v;
+            }
+        }
+    }
+}
+
+//==============================================================================
+ConvolutionReverb::Engine::Engine (const AudioBuffer<float>& impulse, const FFT& fft)
+    : numPartitions (jmax (1, (impulse.getNumSamples() + blockSize - 1) / blockSize)),
+      numDelaySlots (numPartitions + numHeadPartitions),
+      partitions ((size_t) (numChannels * numPartitions * numBins)),
+      inputSpectra ((size_t) (numChannels * numDelaySlots * numBins)),
+      tailSpectra ((size_t) (numChannels * numTailSlots * numBins))
+{
+    std::vector<Complex> buffer ((size_t) fftSize);
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        auto source = impulse.getReadPointer (jmin (channel, impulse.getNumChannels() - 1));
+
+        for (int partition = 0; partition < numPartitions; ++partition) {
+            // each partition sits in the first half of the transform, zero-padded after it
+            std::fill (buffer.begin(), buffer.end(), Complex());
+            auto offset = partition * blockSize;
+            auto numToCopy = jmin (blockSize, impulse.getNumSamples() - offset);
+
+            for (int i = 0; i < numToCopy; ++i) {
+                buffer[(size_t) i] = source[offset + i];
+            }
+
+            fft.perform (buffer.data(), false);
+            std::copy (buffer.begin(), buffer.begin() + numBins,
+                       partitions.begin() + (channel * numPartitions + partition) * numBins);
+        }
+    }
+}
+
+const ConvolutionReverb::Complex* ConvolutionReverb::Engine::getPartition (int channel, int index) const noexcept {
+    return partitions.data() + (channel * numPartitions + index) * numBins;
+}
+
+ConvolutionReverb::Complex* ConvolutionReverb::Engine::getInputSpectrum (int channel, int64 block) noexcept {
+    return inputSpectra.data() + (channel * numDelaySlots + (int) (block % numDelaySlots)) * numBins;
+}
+
+ConvolutionReverb::Complex* ConvolutionReverb::Engine::getTailSpectrum (int channel, int64 block) noexcept {
+    return tailSpectra.data() + (channel * numTailSlots + (int) (block % numTailSlots)) * numBins;
+}
+
+//==============================================================================
+ConvolutionReverb::ConvolutionReverb() : Thread ("hiSampler convolution") {}
+
+ConvolutionReverb::~ConvolutionReverb() {
+    stopThread (4000);
+
+    delete pendingEngine.exchange (nullptr);
+    delete activeEngine.exchange (nullptr);
+    delete retiredEngine.exchange (nullptr);
+}
+
+void ConvolutionReverb::prepare (double newSampleRate, int /*maximumBlockSize*/) {
+    // the impulse response was resampled for the old rate, so decode it again
+    if (sampleRate.exchange (newSampleRate) != newSampleRate) {
+        const ScopedLock sl (loadLock);
+
+        if (impulseFile != File()) {
+            fileToLoad = impulseFile;
+            notify();
+        }
+    }
+
+    inputBlock.setSize (numChannels, blockSize);
+    previousInput.setSize (numChannels, blockSize);
+    outputBlock.setSize (numChannels, blockSize);
+    inputBlock.clear();
+    previousInput.clear();
+    outputBlock.clear();
+
+    fftBuffer.resize ((size_t) fftSize);
+    blockPosition = 0;
+    numSilentBlocks = 0;
+}
+
+void ConvolutionReverb::loadImpulseResponse (const File& file, AudioFormatManager& formatManager) {
+    {
+        const ScopedLock sl (loadLock);
+        fileToLoad = file;
+        impulseFile = file;
+        loadFormatManager = &formatManager;
+    }
+
+    // nothing runs in the background until the first impulse response is loaded
+    if (! isThreadRunning()) {
+        startThread (7);
+    }
+
+    notify();
+}
+
+//==============================================================================
+void ConvolutionReverb::process (AudioBuffer<float>& buffer, float wetLevel) noexcept {
+    auto* engine = activeEngine.load (std::memory_order_acquire);
+
+    // pick up a newly loaded impulse response once the previous one has been deleted
+    if (pendingEngine.load (std::memory_order_relaxed) != nullptr && retiredEngine.load() == nullptr) {
+        if (auto* fresh = pendingEngine.exchange (nullptr)) {
+            retiredEngine.store (engine);
+            activeEngine.store (fresh, std::memory_order_release);
+            engine = fresh;
+            numSilentBlocks = 0;
+        }
+    }
+
+    if (engine == nullptr || buffer.getNumChannels() == 0) {
+        return;
+    }
+
+    auto numSamples = buffer.getNumSamples();
+    auto numBufferChannels = jmin (numChannels, buffer.getNumChannels());
+    int done = 0;
+
+    while (done < numSamples) {
+        auto numThisTime = jmin (numSamples - done, blockSize - blockPosition);
+
+        for (int channel = 0; channel < numChannels; ++channel) {
+            inputBlock.copyFrom (channel, blockPosition, buffer, jmin (channel, numBufferChannels - 1), done, numThisTime);
+        }
+
+        // the output is always one internal block behind the input
+        for (int channel = 0; channel < numBufferChannels; ++channel) {
+            buffer.copyFrom (channel, done, outputBlock, channel, blockPosition, numThisTime);
+        }
+
+        blockPosition += numThisTime;
+        done += numThisTime;
+
+        if (blockPosition == blockSize) {
+            processBlock (*engine, wetLevel);
+            blockPosition = 0;
+        }
+    }
+}
+
+void ConvolutionReverb::processBlock (Engine& engine, float wetLevel) noexcept {
+    bool isSilent = true;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        isSilent = isSilent && inputBlock.getMagnitude (channel, 0, blockSize) == 0.0f;
+    }
+
+    numSilentBlocks = isSilent ? numSilentBlocks + 1 : 0;
+
+    // by now every spectrum in the delay line is silent, so the output would be too
+    if (numSilentBlocks > engine.numDelaySlots) {
+        outputBlock.clear();
+        return;
+    }
+
+    auto block = engine.currentBlock.load (std::memory_order_relaxed) + 1;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        // overlap-save: the previous block followed by this one
+        auto previous = previousInput.getReadPointer (channel);
+        auto input = inputBlock.getReadPointer (channel);
+
+        for (int i = 0; i < blockSize; ++i) {
+            fftBuffer[(size_t) i] = previous[i];
+            fftBuffer[(size_t) (blockSize + i)] = input[i];
+        }
+
+        fft.perform (fftBuffer.data(), false);
+        std::copy (fftBuffer.begin(), fftBuffer.begin() + numBins, engine.getInputSpectrum (channel, block));
+
+        previousInput.copyFrom (channel, 0, inputBlock, channel, 0, blockSize);
+    }
+
+    // the background thread may now use this block's spectra
+    engine.currentBlock.store (block, std::memory_order_release);
+
+    auto numHead = jmin (numHeadPartitions, engine.numPartitions);
+    auto hasTail = engine.numPartitions > numHeadPartitions && block >= numHeadPartitions;
+    auto tailIsReady = hasTail && engine.tailDoneBlock.load (std::memory_order_acquire) >= block;
+
+    if (hasTail && ! tailIsReady) {
+        ++numLateTails;
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        auto* acc = fftBuffer.data();
+        std::fill (acc, acc + numBins, Complex());
+
+        for (int k = 0; k < numHead && k <= block; ++k) {
+            auto* x = engine.getInputSpectrum (channel, block - k);
+            auto* h = engine.getPartition (channel, k);
+
+            for (int bin = 0; bin < numBins; ++bin) {
+                acc[bin] += x[bin] * h[bin];
+            }
+        }
+
+        if (tailIsReady) {
+            auto* tail = engine.getTailSpectrum (channel, block);
+
+            for (int bin = 0; bin < numBins; ++bin) {
+                acc[bin] += tail[bin];
+            }
+        }
+
+        // real signal, so the upper half mirrors the lower one
+        for (int bin = 1; bin < blockSize; ++bin) {
+            acc[fftSize - bin] = std::conj (acc[bin]);
+        }
+
+        fft.perform (acc, true);
+
+        auto input = inputBlock.getReadPointer (channel);
+        auto output = outputBlock.getWritePointer (channel);
+        auto scale = wetLevel / (float) fftSize;
+
+        for (int i = 0; i < blockSize; ++i) {
+            output[i] = input[i] + acc[blockSize + i].real() * scale;
+        }
+    }
+}
+
+//==============================================================================
+void ConvolutionReverb::run() {
+    Engine* announcedEngine = nullptr;
+    int64 lastSeenBlock = -1;
+
+    while (! threadShouldExit()) {
+        // whatever the audio thread swapped out last time is no longer in use by anyone
+        delete retiredEngine.exchange (nullptr);
+
+        // only now does the impulse response (and the latency that comes with it) take effect
+        auto* active = activeEngine.load (std::memory_order_acquire);
+
+        if (active != announcedEngine) {
+            announcedEngine = active;
+            impulseLoaded = active != nullptr;
+
+            if (onImpulseResponseChanged != nullptr) {
+                onImpulseResponseChanged();
+            }
+        }
+
+        File file;
+
+        {
+            const ScopedLock sl (loadLock);
+            std::swap (file, fileToLoad);
+        }
+
+        if (file != File()) {
+            if (auto engine = createEngine (file)) {
+                delete pendingEngine.exchange (engine.release());
+            }
+        }
+
+        bool didWork = false;
+        bool audioMoved = false;
+
+        if (auto* engine = activeEngine.load (std::memory_order_acquire)) {
+            auto current = engine->currentBlock.load (std::memory_order_acquire);
+            audioMoved = current != lastSeenBlock;
+            lastSeenBlock = current;
+
+            for (auto block = jmax ((int64) 0, engine->tailDoneBlock.load() - numHeadPartitions + 1); block <= current; ++block) {
+                auto target = block + numHeadPartitions;
+
+                // if the audio thread has already got there, it's gone without this tail
+                if (target > engine->currentBlock.load (std::memory_order_acquire)) {
+                    computeTail (*engine, target);
+                }
+
+                engine->tailDoneBlock.store (target, std::memory_order_release);
+                didWork = true;
+            }
+        }
+
+        if (! didWork) {
+            // while the audio thread is stopped (or has no impulse response) there's nothing
+            // to keep up with, so poll a few times per tail deadline instead of every millisecond
+            auto rate = sampleRate.load();
+            auto deadlineMs = rate > 0.0 ? numHeadPartitions * blockSize * 1000.0 / rate : 20.0;
+            wait (audioMoved ? 1 : jmax (1, (int) (deadlineMs / 4.0)));
+        }
+    }
+}
+
+void ConvolutionReverb::computeTail (Engine& engine, int64 targetBlock) noexcept {
+    // everything from numHeadPartitions onwards, using inputs the audio thread already has
+    auto newestBlock = targetBlock - numHeadPartitions;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        auto* acc = engine.getTailSpectrum (channel, targetBlock);
+        std::fill (acc, acc + numBins, Complex());
+
+        for (int partition = numHeadPartitions; partition < engine.numPartitions; ++partition) {
+            auto inputBlockIndex = newestBlock - (partition - numHeadPartitions);
+
+            if (inputBlockIndex < 0) {
+                break;
+            }
+
+            auto* x = engine.getInputSpectrum (channel, inputBlockIndex);
+            auto* h = engine.getPartition (channel, partition);
+
+            for (int bin = 0; bin < numBins; ++bin) {
+                acc[bin] += x[bin] * h[bin];
+            }
+        }
+    }
+}
+
+std::unique_ptr<ConvolutionReverb::Engine> ConvolutionReverb::createEngine (const File& file) {
+    AudioFormatManager* formatManager;
+
+    {
+        const ScopedLock sl (loadLock);
+        formatManager = loadFormatManager;
+    }
+
+    if (formatManager == nullptr) {
+        return {};
+    }
+
+    std::unique_ptr<AudioFormatReader> reader (formatManager->createReaderFor (file));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0) {
+        return {};
+    }
+
+    auto length = (int) jmin (reader->lengthInSamples, (int64) (maxImpulseLengthSeconds * reader->sampleRate));
+    AudioBuffer<float> impulse (jmin (numChannels, (int) reader->numChannels), length);
+    reader->read (&impulse, 0, length, 0, true, true);
+
+    impulseLengthSeconds = length / reader->sampleRate;
+
+    // before we've been prepared there's no rate to match; prepare() loads the file again
+    auto targetSampleRate = sampleRate.load();
+
+    if (targetSampleRate > 0.0 && targetSampleRate != reader->sampleRate) {
+        impulse = resampleImpulse (impulse, reader->sampleRate, targetSampleRate);
+    }
+
+    normaliseImpulse (impulse);
+    return std::make_unique<Engine> (impulse, fft);
+}
+
+AudioBuffer<float> ConvolutionReverb::resampleImpulse (AudioBuffer<float>& impulse, double sourceSampleRate, double targetSampleRate) {
+    auto newLength = jmax (1, roundToInt (impulse.getNumSamples() * targetSampleRate / sourceSampleRate));
+    AudioBuffer<float> resampled (impulse.getNumChannels(), newLength);
+
+    // the same filtered resampler dsp::Convolution uses, so downsampling doesn't alias
+    MemoryAudioSource memorySource (impulse, false);
+    ResamplingAudioSource resamplingSource (&memorySource, false, impulse.getNumChannels());
+    resamplingSource.setResamplingRatio (sourceSampleRate / targetSampleRate);
+    resamplingSource.prepareToPlay (newLength, targetSampleRate);
+
+    AudioSourceChannelInfo info (&resampled, 0, newLength);
+    resamplingSource.getNextAudioBlock (info);
+    return resampled;
+}
+
+void ConvolutionReverb::normaliseImpulse (AudioBuffer<float>& impulse) {
+    // unit energy in the loudest channel, as dsp::Convolution does, so every file sits at a similar level
+    float maxEnergy = 0.0f;
+
+    for (int channel = 0; channel < impulse.getNumChannels(); ++channel) {
+        auto samples = impulse.getReadPointer (channel);
+        float energy = 0.0f;
+
+        for (int i = 0; i < impulse.getNumSamples(); ++i) {
+            energy += samples[i] * samples[i];
+        }
+
+        maxEnergy = jmax (maxEnergy, energy);
+    }
+
+    if (maxEnergy > 0.0f) {
+        impulse.applyGain (1.0f / std::sqrt (maxEnergy));
+    }
+}
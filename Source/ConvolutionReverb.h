@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    ConvolutionReverb.h
+    Uniformly partitioned overlap-save convolution, run after the sampler.
+    The first few partitions (the head) are convolved on the audio thread;
+    the rest of the impulse response (the tail) is convolved ahead of time on
+    a background thread, which has numHeadPartitions blocks to deliver it.
+
+    Impulse responses are decoded, resampled to the playback rate, normalised
+    and transformed on that same background thread, and handed to the audio
+    thread with an atomic pointer swap. Once
+    the input has been silent long enough for the tail to ring out, blocks
+    are skipped entirely.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class ConvolutionReverb : private Thread
+{
+public:
+    ConvolutionReverb();
+    ~ConvolutionReverb() override;
+
+    // Internal block size, and so the latency the reverb adds while it has an impulse response
+    static constexpr int blockSize = 128;
+
+    // Reloads the current impulse response if the sample rate has changed
+    void prepare (double sampleRate, int maximumBlockSize);
+
+    // Message thread: decodes the file on the background thread, then swaps it in
+    void loadImpulseResponse (const File& file, AudioFormatManager& formatManager);
+    // True once the audio thread is actually using an impulse response
+    bool hasImpulseResponse() const noexcept { return impulseLoaded; }
+
+    // Called on the background thread when the audio thread has swapped in a new impulse
+    // response; a file that fails to load never gets this far.
+    std::function<void()> onImpulseResponseChanged;
+    double getTailLengthSeconds() const noexcept { return impulseLengthSeconds; }
+
+    // Audio thread: adds the reverb to the first two channels in place, delayed by blockSize
+    void process (AudioBuffer<float>& buffer, float wetLevel) noexcept;
+
+    // Tail blocks the background thread didn't deliver in time (and that were left out)
+    int getNumLateTails() const noexcept { return numLateTails; }
+
+private:
+    using Complex = std::complex<float>;
+
+    static constexpr int fftSize = 2 * blockSize;
+    static constexpr int numBins = blockSize + 1;   // the rest follow from symmetry
+    static constexpr int numHeadPartitions = 8;
+    static constexpr int numTailSlots = 2 * numHeadPartitions;
+    static constexpr int numChannels = 2;
+    static constexpr double maxImpulseLengthSeconds = 10.0;
+
+    //==============================================================================
+    class FFT
+    {
+    public:
+        explicit FFT (int size);
+        void perform (Complex* data, bool inverse) const noexcept;
+
+    private:
+        int size;
+        std::vector<Complex> twiddles;
+        std::vector<int> bitReversed;
+    };
+
+    // One impulse response plus all the convolution state that goes with it, so
+    // swapping impulse responses never mixes state between the two.
+    struct Engine
+    {
+        Engine (const AudioBuffer<float>& impulse, const FFT& fft);
+
+        const Complex* getPartition (int channel, int index) const noexcept;
+        Complex* getInputSpectrum (int channel, int64 block) noexcept;
+        Complex* getTailSpectrum (int channel, int64 block) noexcept;
+
+        int numPartitions = 0;
+        int numDelaySlots = 0;
+        std::vector<Complex> partitions;       // [channel][partition][bin]
+        std::vector<Complex> inputSpectra;     // [channel][block % numDelaySlots][bin]
+        std::vector<Complex> tailSpectra;      // [channel][block % numTailSlots][bin]
+
+        std::atomic<int64> currentBlock { -1 };    // last block the audio thread transformed
+        std::atomic<int64> tailDoneBlock { -1 };   // last block whose tail is ready
+    };
+
+    void run() override;
+    void processBlock (Engine& engine, float wetLevel) noexcept;
+    void computeTail (Engine& engine, int64 targetBlock) noexcept;
+    std::unique_ptr<Engine> createEngine (const File& file);
+
+    static AudioBuffer<float> resampleImpulse (AudioBuffer<float>& impulse, double sourceSampleRate, double targetSampleRate);
+    static void normaliseImpulse (AudioBuffer<float>& impulse);
+
+    FFT fft { fftSize };
+
+    // message thread -> background thread
+    CriticalSection loadLock;
+    File fileToLoad, impulseFile;   // impulseFile is the latest request, kept for reloading at a new rate
+    AudioFormatManager* loadFormatManager { nullptr };
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<bool> impulseLoaded { false };
+    std::atomic<double> impulseLengthSeconds { 0.0 };
+
+    // background thread -> audio thread, and back again for deletion
+    std::atomic<Engine*> pendingEngine { nullptr };
+    std::atomic<Engine*> activeEngine { nullptr };
+    std::atomic<Engine*> retiredEngine { nullptr };
+
+    // audio thread only
+    AudioBuffer<float> inputBlock, previousInput, outputBlock;
+    std::vector<Complex> fftBuffer;
+    int blockPosition { 0 };
+    int64 numSilentBlocks { 0 };
+
+    std::atomic<int> numLateTails { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolutionReverb)
+};
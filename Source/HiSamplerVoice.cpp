@@ -0,0 +1,407 @@
+/*
+  ==============================================================================
+
+    HiSamplerVoice.cpp
+
+  ==============================================================================
+*/
+
+#include "HiSamplerVoice.h"
+
+namespace
+{
+    // shared by every sound, so renders can be compared across sounds when evicting
+    std::atomic<uint32> renderUseCounter { 0 };
+}
+
+//==============================================================================
+HiSamplerSound::HiSamplerSound (const String& soundName,
+                                AudioFormatReader& source,
+                                const BigInteger& notes,
+                                int midiNoteForNormalPitch,
+                                double attackTimeSecs,
+                                double releaseTimeSecs,
+                                double maxSampleLengthSeconds)
+    : name (soundName),
+      sourceSampleRate (source.sampleRate),
+      midiNotes (notes),
+      midiRootNote (midiNoteForNormalPitch)
+{
+    if (sourceSampleRate > 0 && source.lengthInSamples > 0) {
+        length = jmin ((int) source.lengthInSamples,
+                       (int) (maxSampleLengthSeconds * sourceSampleRate));
+
+        // a few extra samples so the interpolator can always read pos + 1. Arena memory
+        // is prefaulted here, so voices don't take page faults on first playback.
+        data.reset (new ArenaAudioBuffer (jmin (2, (int) source.numChannels), length + 4));
+        source.read (&data->getBuffer(), 0, length + 4, 0, true, true);
+        analysis = SampleAnalysis::analyse (data->getBuffer(), length);
+
+        params.attack  = static_cast<float> (attackTimeSecs);
+        params.release = static_cast<float> (releaseTimeSecs);
+    }
+}
+
+HiSamplerSound::HiSamplerSound (const String& soundName,
+                                const AudioBuffer<float>& sourceData,
+                                int sourceLength,
+                                double sampleRate,
+                                const BigInteger& notes,
+                                int midiNoteForNormalPitch,
+                                double attackTimeSecs,
+                                double releaseTimeSecs)
+    : name (soundName),
+      data (new ArenaAudioBuffer (jmin (2, sourceData.getNumChannels()), sourceLength + 4)),
+      sourceSampleRate (sampleRate),
+      midiNotes (notes),
+      length (sourceLength),
+      midiRootNote (midiNoteForNormalPitch)
+{
+    // the arena hands out silence, so the 4 samples after the end are already clear
+    for (int channel = 0; channel < data->getBuffer().getNumChannels(); ++channel) {
+        data->getBuffer().copyFrom (channel, 0, sourceData, channel, 0, length);
+    }
+
+    analysis = SampleAnalysis::analyse (data->getBuffer(), length);
+
+    params.attack  = static_cast<float> (attackTimeSecs);
+    params.release = static_cast<float> (releaseTimeSecs);
+}
+
+HiSamplerSound::~HiSamplerSound() {}
+
+void HiSamplerSound::setProgram (const ProgramBank* owner, const std::atomic<ProgramBank*>* selectedProgram) noexcept {
+    program = owner;
+    selection = selectedProgram;
+}
+
+bool HiSamplerSound::appliesToNewNote (int midiNoteNumber) const noexcept {
+    // a program change is just a different pointer here, so it needs no locking
+    if (selection != nullptr && selection->load (std::memory_order_acquire) != program) {
+        return false;
+    }
+
+    return midiNotes[midiNoteNumber];
+}
+
+bool HiSamplerSound::appliesToNote (int midiNoteNumber) {
+    // noteOff asks this too, so it mustn't depend on the selected program
+    // or notes started before a program change would never be released
+    return midiNotes[midiNoteNumber];
+}
+
+bool HiSamplerSound::appliesToChannel (int /*midiChannel*/) {
+    return true;
+}
+
+double HiSamplerSound::getPitchRatio (int midiNoteNumber, double playbackSampleRate) const noexcept {
+    return std::pow (2.0, (midiNoteNumber - midiRootNote) / 12.0) * sourceSampleRate / playbackSampleRate;
+}
+
+Range<int> HiSamplerSound::getPlaybackRange (const SampleView& viewToUse) const noexcept {
+    auto trimStart = viewToUse.getStartSample (length);
+    auto trimEnd = viewToUse.getEndSample (length);
+
+    // skip the silence before the onset, and move trims onto zero crossings so they don't click
+    auto start = trimStart <= analysis.onset ? analysis.onset : analysis.getNearestZeroCrossing (trimStart, maxZeroCrossingSnap);
+    auto end = trimEnd < length ? analysis.getNearestZeroCrossing (trimEnd, maxZeroCrossingSnap) : trimEnd;
+    return { start, jmax (start, end) };
+}
+
+void HiSamplerSound::setRenderSampleRate (double playbackSampleRate) {
+    const ScopedLock sl (renderLock);
+
+    if (playbackSampleRate == renderSampleRate) {
+        return;
+    }
+
+    renderSampleRate = playbackSampleRate;
+
+    for (int note = 0; note < numMidiNotes; ++note) {
+        renderReady[note] = false;
+        renderRequested[note] = false;
+        renders[note].reset();
+    }
+
+    renderBytes = 0;
+}
+
+const AudioBuffer<float>* HiSamplerSound::acquireCachedRender (int midiNoteNumber, double playbackSampleRate) noexcept {
+    // renderSampleRate only changes while the audio callback is stopped
+    if (! renderCacheEnabled || ! isPositiveAndBelow (midiNoteNumber, numMidiNotes) || playbackSampleRate != renderSampleRate) {
+        return nullptr;
+    }
+
+    renderLastUsed[midiNoteNumber].store (++renderUseCounter, std::memory_order_relaxed);
+
+    // claim it before checking it's there; evictRender does the opposite, so one of us always
+    // sees the other (both sequentially consistent)
+    ++renderUsers[midiNoteNumber];
+
+    if (! renderReady[midiNoteNumber].load()) {
+        --renderUsers[midiNoteNumber];
+        return nullptr;
+    }
+
+    return &renders[midiNoteNumber]->getBuffer();
+}
+
+void HiSamplerSound::releaseCachedRender (int midiNoteNumber) noexcept {
+    --renderUsers[midiNoteNumber];
+}
+
+void HiSamplerSound::requestRender (int midiNoteNumber) noexcept {
+    if (renderCacheEnabled && isPositiveAndBelow (midiNoteNumber, numMidiNotes)) {
+        renderLastUsed[midiNoteNumber].store (++renderUseCounter, std::memory_order_relaxed);
+        renderRequested[midiNoteNumber].store (true, std::memory_order_relaxed);
+    }
+}
+
+int HiSamplerSound::getLeastRecentlyUsedRender (uint32& lastUsed) const noexcept {
+    int oldest = -1;
+
+    for (int note = 0; note < numMidiNotes; ++note) {
+        if (renderReady[note] && renderUsers[note] == 0) {
+            auto used = renderLastUsed[note].load (std::memory_order_relaxed);
+
+            if (oldest < 0 || used < lastUsed) {
+                oldest = note;
+                lastUsed = used;
+            }
+        }
+    }
+
+    return oldest;
+}
+
+int64 HiSamplerSound::evictRender (int midiNoteNumber) {
+    const ScopedLock sl (renderLock);
+
+    if (! renderReady[midiNoteNumber]) {
+        return 0;
+    }
+
+    renderReady[midiNoteNumber] = false;
+
+    // a voice got in first, so put it back and leave it
+    if (renderUsers[midiNoteNumber] > 0) {
+        renderReady[midiNoteNumber] = true;
+        return 0;
+    }
+
+    auto& buffer = renders[midiNoteNumber]->getBuffer();
+    auto bytes = (int64) buffer.getNumChannels() * buffer.getNumSamples() * (int64) sizeof (float);
+
+    renders[midiNoteNumber].reset();
+    renderBytes -= bytes;
+    return bytes;
+}
+
+bool HiSamplerSound::renderPendingNotes (const std::function<bool (int64)>& makeRoom) {
+    const ScopedLock sl (renderLock);
+
+    if (data == nullptr || renderSampleRate <= 0) {
+        return false;
+    }
+
+    bool renderedAny = false;
+
+    for (int note = 0; note < numMidiNotes; ++note) {
+        if (! renderRequested[note].exchange (false, std::memory_order_relaxed) || renderReady[note]) {
+            continue;
+        }
+
+        auto ratio = getPitchRatio (note, renderSampleRate);
+
+        // same number of output samples as a live voice produces before it stops
+        auto renderLength = (int) (length / ratio) + 1;
+
+        if (length / ratio > maxRenderLengthSeconds * renderSampleRate) {
+            continue;
+        }
+
+        auto& source = data->getBuffer();
+        auto bytes = (int64) source.getNumChannels() * renderLength * (int64) sizeof (float);
+
+        // the budget is checked per note, so a run across the keyboard never overshoots it
+        if (! makeRoom (bytes)) {
+            continue;
+        }
+
+        auto render = std::make_unique<ArenaAudioBuffer> (source.getNumChannels(), renderLength);
+
+        for (int channel = 0; channel < source.getNumChannels(); ++channel) {
+            auto in = source.getReadPointer (channel);
+            auto out = render->getBuffer().getWritePointer (channel);
+            double position = 0.0;
+
+            for (int i = 0; i < renderLength; ++i) {
+                auto pos = (int) position;
+                auto alpha = (float) (position - pos);
+                out[i] = in[pos] * (1.0f - alpha) + in[pos + 1] * alpha;
+                position += ratio;
+            }
+        }
+
+        renderBytes += bytes;
+        renders[note] = std::move (render);
+        renderReady[note].store (true, std::memory_order_release);
+        renderedAny = true;
+    }
+
+    return renderedAny;
+}
+
+//==============================================================================
+HiSamplerVoice::HiSamplerVoice() {}
+HiSamplerVoice::~HiSamplerVoice() {}
+
+bool HiSamplerVoice::canPlaySound (SynthesiserSound* sound) {
+    return dynamic_cast<const HiSamplerSound*> (sound) != nullptr;
+}
+
+void HiSamplerVoice::startNote (int midiNoteNumber, float velocity, SynthesiserSound* s, int /*currentPitchWheelPosition*/) {
+    if (auto* sound = dynamic_cast<HiSamplerSound*> (s)) {
+        const auto& view = sound->view;
+        const auto& analysis = sound->analysis;
+
+        pitchRatio = sound->getPitchRatio (midiNoteNumber, getSampleRate());
+
+        auto range = sound->getPlaybackRange (view);
+        startPosition = range.getStart();
+        endPosition = range.getEnd();
+        sourceSamplePosition = view.reversed ? endPosition : startPosition;
+        sampleIncrement = view.reversed ? -pitchRatio : pitchRatio;
+
+        // play the pre-rendered copy if there is one, otherwise interpolate and ask for it
+        releaseCachedRender();
+        cachedRender = sound->acquireCachedRender (midiNoteNumber, getSampleRate());
+
+        if (cachedRender != nullptr) {
+            cachedRenderSound = sound;
+            cachedRenderNote = midiNoteNumber;
+
+            // render sample i sits at source position i * pitchRatio
+            auto lastIndex = cachedRender->getNumSamples() - 1;
+            renderFirst = jmin (lastIndex, (int) std::ceil (startPosition / pitchRatio));
+            renderLast = jlimit (renderFirst, lastIndex, (int) (endPosition / pitchRatio));
+            renderPosition = view.reversed ? renderLast : renderFirst;
+            renderStep = view.reversed ? -1 : 1;
+        }
+        else {
+            sound->requestRender (midiNoteNumber);
+        }
+
+        auto level = view.getLevel (analysis.peak);
+        lgain = velocity * level;
+        rgain = velocity * level;
+
+        adsr.setSampleRate (getSampleRate());
+        adsr.setParameters (sound->params);
+        adsr.noteOn();
+    }
+    else {
+        jassertfalse; // this object can only play HiSamplerSounds!
+    }
+}
+
+void HiSamplerVoice::stopNote (float /*velocity*/, bool allowTailOff) {
+    if (allowTailOff) {
+        adsr.noteOff();
+    }
+    else {
+        // before clearCurrentNote, which may drop the last reference the voice has to the sound
+        releaseCachedRender();
+        clearCurrentNote();
+        adsr.reset();
+    }
+}
+
+void HiSamplerVoice::releaseCachedRender() noexcept {
+    if (cachedRender != nullptr) {
+        cachedRenderSound->releaseCachedRender (cachedRenderNote);
+        cachedRender = nullptr;
+        cachedRenderSound = nullptr;
+    }
+}
+
+void HiSamplerVoice::pitchWheelMoved (int /*newValue*/) {}
+void HiSamplerVoice::controllerMoved (int /*controllerNumber*/, int /*newValue*/) {}
+
+//==============================================================================
+void HiSamplerVoice::renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples) {
+    auto* playingSound = static_cast<HiSamplerSound*> (getCurrentlyPlayingSound().get());
+
+    if (playingSound == nullptr) {
+        return;
+    }
+
+    float* outL = outputBuffer.getWritePointer (0, startSample);
+    float* outR = outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer (1, startSample) : nullptr;
+
+    if (cachedRender != nullptr) {
+        // pre-rendered: a gain-scaled copy, no interpolation
+        const float* const inL = cachedRender->getReadPointer (0);
+        const float* const inR = cachedRender->getNumChannels() > 1 ? cachedRender->getReadPointer (1) : nullptr;
+
+        while (--numSamples >= 0) {
+            auto envelopeValue = adsr.getNextSample();
+            float l = inL[renderPosition];
+            float r = (inR != nullptr) ? inR[renderPosition] : l;
+
+            l *= lgain * envelopeValue;
+            r *= rgain * envelopeValue;
+
+            if (outR != nullptr) {
+                *outL++ += l;
+                *outR++ += r;
+            }
+            else {
+                *outL++ += (l + r) * 0.5f;
+            }
+
+            renderPosition += renderStep;
+
+            if (renderPosition < renderFirst || renderPosition > renderLast || ! adsr.isActive()) {
+                stopNote (0.0f, false);
+                break;
+            }
+        }
+
+        return;
+    }
+
+    auto& data = playingSound->data->getBuffer();
+    const float* const inL = data.getReadPointer (0);
+    const float* const inR = data.getNumChannels() > 1 ? data.getReadPointer (1) : nullptr;
+
+    while (--numSamples >= 0) {
+        auto pos = (int) sourceSamplePosition;
+        auto alpha = (float) (sourceSamplePosition - pos);
+        auto invAlpha = 1.0f - alpha;
+
+        // just using a very simple linear interpolation here..
+        float l = (inL[pos] * invAlpha + inL[pos + 1] * alpha);
+        float r = (inR != nullptr) ? (inR[pos] * invAlpha + inR[pos + 1] * alpha) : l;
+
+        auto envelopeValue = adsr.getNextSample();
+
+        l *= lgain * envelopeValue;
+        r *= rgain * envelopeValue;
+
+        if (outR != nullptr) {
+            *outL++ += l;
+            *outR++ += r;
+        }
+        else {
+            *outL++ += (l + r) * 0.5f;
+        }
+
+        sourceSamplePosition += sampleIncrement;
+
+        if (sourceSamplePosition > endPosition || sourceSamplePosition < startPosition || ! adsr.isActive()) {
+            stopNote (0.0f, false);
+            break;
+        }
+    }
+}
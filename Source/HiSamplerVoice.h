@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+    HiSamplerVoice.h
+    The sampler sound and voice used by HiSamplerAudioProcessor. These follow
+    JUCE's SamplerSound/SamplerVoice, but keep their state accessible so the
+    processor can add caching and other playback features on top.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleView.h"
+#include "SampleMemoryArena.h"
+#include "SampleAnalysis.h"
+
+class ProgramBank;
+
+//==============================================================================
+class HiSamplerSound : public SynthesiserSound
+{
+public:
+    HiSamplerSound (const String& name,
+                    AudioFormatReader& source,
+                    const BigInteger& midiNotes,
+                    int midiNoteForNormalPitch,
+                    double attackTimeSecs,
+                    double releaseTimeSecs,
+                    double maxSampleLengthSeconds);
+
+    // Copies audio that's already in memory, e.g. a recorded take, into the sample arena
+    HiSamplerSound (const String& name,
+                    const AudioBuffer<float>& sourceData,
+                    int length,
+                    double sourceSampleRate,
+                    const BigInteger& midiNotes,
+                    int midiNoteForNormalPitch,
+                    double attackTimeSecs,
+                    double releaseTimeSecs);
+
+    ~HiSamplerSound() override;
+
+    using Ptr = ReferenceCountedObjectPtr<HiSamplerSound>;
+
+    const String& getName() const noexcept { return name; }
+    AudioBuffer<float>* getAudioData() const noexcept { return data != nullptr ? &data->getBuffer() : nullptr; }
+
+    void setEnvelopeParameters (ADSR::Parameters parametersToUse) { params = parametersToUse; }
+    ADSR::Parameters getEnvelopeParameters() const noexcept { return params; }
+
+    // The edits voices apply when they start a note. Set this from the audio thread,
+    // or before the sound is handed to the synth.
+    void setView (const SampleView& newView) noexcept { view = newView; }
+    const SampleView& getView() const noexcept { return view; }
+
+    int getLength() const noexcept { return length; }
+    float getPeak() const noexcept { return analysis.peak; }
+
+    // Measured when the sound is created, off the audio thread
+    const SampleAnalysis& getAnalysis() const noexcept { return analysis; }
+
+    // The samples a voice plays with this view: the silence before the onset is skipped
+    // and trims move onto nearby zero crossings. Fine to call from any thread.
+    Range<int> getPlaybackRange (const SampleView& viewToUse) const noexcept;
+
+    // Ties the sound to a program: it then only answers new notes while selectedProgram
+    // points at that program. Call this before the sound is handed to the synth.
+    void setProgram (const ProgramBank* owner, const std::atomic<ProgramBank*>* selectedProgram) noexcept;
+    const ProgramBank* getProgram() const noexcept { return program; }
+
+    // Whether a note starting now should use this sound. Unlike appliesToNote, which the
+    // synth also asks when a note ends, this is false while another program is selected.
+    bool appliesToNewNote (int midiNoteNumber) const noexcept;
+
+    bool appliesToNote (int midiNoteNumber) override;
+    bool appliesToChannel (int midiChannel) override;
+
+    //==============================================================================
+    // Note render cache: fully resampled copies of the sample, one per MIDI note,
+    // so repeated one-shot hits play back without interpolating again.
+    void setRenderCacheEnabled (bool shouldBeEnabled) noexcept { renderCacheEnabled = shouldBeEnabled; }
+    bool isRenderCacheEnabled() const noexcept { return renderCacheEnabled; }
+
+    // Drops every cached render. Only call this while the audio callback isn't running
+    // (e.g. from prepareToPlay), since voices may be reading from the renders.
+    void setRenderSampleRate (double playbackSampleRate);
+
+    // Audio thread: returns the render for this note if it's ready, or nullptr. A render that's
+    // returned can't be evicted until releaseCachedRender is called for the same note.
+    const AudioBuffer<float>* acquireCachedRender (int midiNoteNumber, double playbackSampleRate) noexcept;
+    void releaseCachedRender (int midiNoteNumber) noexcept;
+    // Audio thread: flags a note for the background renderer. Never allocates.
+    void requestRender (int midiNoteNumber) noexcept;
+    // Background thread: renders every requested note. Before each render, makeRoom is given the
+    // bytes it needs and returns false if it can't free enough, in which case that note is skipped.
+    // Returns true if anything was rendered.
+    bool renderPendingNotes (const std::function<bool (int64)>& makeRoom);
+
+    // Background thread: what the renders take up, and the one played longest ago (-1 if none)
+    int64 getRenderCacheBytes() const noexcept { return renderBytes; }
+    int getLeastRecentlyUsedRender (uint32& lastUsed) const noexcept;
+    // Background thread: frees a render unless a voice is playing it. Returns the bytes freed.
+    int64 evictRender (int midiNoteNumber);
+
+    double getPitchRatio (int midiNoteNumber, double playbackSampleRate) const noexcept;
+
+private:
+    //==============================================================================
+    friend class HiSamplerVoice;
+
+    String name;
+    std::unique_ptr<ArenaAudioBuffer> data;
+    double sourceSampleRate;
+    BigInteger midiNotes;
+    int length = 0, midiRootNote = 0;
+    SampleAnalysis analysis;
+
+    ADSR::Parameters params;
+    SampleView view;
+
+    const ProgramBank* program = nullptr;
+    const std::atomic<ProgramBank*>* selection = nullptr;
+
+    static constexpr int numMidiNotes = 128;
+    static constexpr int maxZeroCrossingSnap = 1024;        // samples a trim may move to avoid a click
+    static constexpr double maxRenderLengthSeconds = 10.0; // skips huge renders far below the root note
+
+    CriticalSection renderLock;
+    double renderSampleRate { 0.0 };
+    std::atomic<bool> renderCacheEnabled { false };
+    std::array<std::unique_ptr<ArenaAudioBuffer>, numMidiNotes> renders;
+    std::array<std::atomic<bool>, numMidiNotes> renderReady {}, renderRequested {};
+    std::array<std::atomic<int>, numMidiNotes> renderUsers {};          // voices playing each render
+    std::array<std::atomic<uint32>, numMidiNotes> renderLastUsed {};    // for evicting the oldest first
+    std::atomic<int64> renderBytes { 0 };
+
+    JUCE_LEAK_DETECTOR (HiSamplerSound)
+};
+
+//==============================================================================
+class HiSamplerVoice : public SynthesiserVoice
+{
+public:
+    HiSamplerVoice();
+    ~HiSamplerVoice() override;
+
+    bool canPlaySound (SynthesiserSound*) override;
+
+    void startNote (int midiNoteNumber, float velocity, SynthesiserSound*, int pitchWheel) override;
+    void stopNote (float velocity, bool allowTailOff) override;
+
+    void pitchWheelMoved (int newValue) override;
+    void controllerMoved (int controllerNumber, int newValue) override;
+
+    void renderNextBlock (AudioBuffer<float>&, int startSample, int numSamples) override;
+    using SynthesiserVoice::renderNextBlock;
+
+private:
+    //==============================================================================
+    double pitchRatio = 0;
+    double sourceSamplePosition = 0;
+    double sampleIncrement = 0;
+    double startPosition = 0, endPosition = 0;
+    float lgain = 0, rgain = 0;
+
+    void releaseCachedRender() noexcept;
+
+    const AudioBuffer<float>* cachedRender = nullptr;
+    HiSamplerSound* cachedRenderSound = nullptr;
+    int cachedRenderNote = 0;
+    int renderPosition = 0, renderStep = 1;
+    int renderFirst = 0, renderLast = 0;
+
+    ADSR adsr;
+
+    JUCE_LEAK_DETECTOR (HiSamplerVoice)
+};
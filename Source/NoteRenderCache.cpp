@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+
+    NoteRenderCache.cpp
+
+  ==============================================================================
+*/
+
+#include "NoteRenderCache.h"
+
+//==============================================================================
+NoteRenderCache::NoteRenderCache() : Thread ("hiSampler note render cache") {}
+
+NoteRenderCache::~NoteRenderCache() {
+    stopThread (2000);
+}
+
+void NoteRenderCache::setSounds (const ReferenceCountedArray<HiSamplerSound>& newSounds) {
+    {
+        const ScopedLock sl (soundLock);
+        sounds = newSounds;
+    }
+
+    // nothing runs in the background until there's a sound to render
+    if (! newSounds.isEmpty() && ! isThreadRunning()) {
+        startThread (3);
+    }
+}
+
+void NoteRenderCache::run() {
+    while (! threadShouldExit()) {
+        ReferenceCountedArray<HiSamplerSound> current;
+
+        {
+            const ScopedLock sl (soundLock);
+            current = sounds;
+        }
+
+        bool renderedAny = false;
+
+        auto makeRoomForRender = [this, &current] (int64 numBytes) {
+            return makeRoom (current, numBytes);
+        };
+
+        for (auto* sound : current) {
+            renderedAny = sound->renderPendingNotes (makeRoomForRender) || renderedAny;
+        }
+
+        // the audio thread only sets flags, so we poll rather than being signalled
+        if (! renderedAny) {
+            wait (pollIntervalMs);
+        }
+    }
+}
+
+bool NoteRenderCache::makeRoom (const ReferenceCountedArray<HiSamplerSound>& current, int64 numBytesNeeded) {
+    auto budget = memoryBudget.load();
+
+    if (numBytesNeeded > budget) {
+        return false;
+    }
+
+    int64 totalBytes = 0;
+
+    for (auto* sound : current) {
+        totalBytes += sound->getRenderCacheBytes();
+    }
+
+    while (totalBytes + numBytesNeeded > budget) {
+        HiSamplerSound* oldestSound = nullptr;
+        int oldestNote = -1;
+        uint32 oldestUse = 0;
+
+        for (auto* sound : current) {
+            uint32 lastUsed = 0;
+            auto note = sound->getLeastRecentlyUsedRender (lastUsed);
+
+            if (note >= 0 && (oldestSound == nullptr || lastUsed < oldestUse)) {
+                oldestSound = sound;
+                oldestNote = note;
+                oldestUse = lastUsed;
+            }
+        }
+
+        // everything left is being played, so this note waits until it's asked for again
+        if (oldestSound == nullptr) {
+            return false;
+        }
+
+        auto freed = oldestSound->evictRender (oldestNote);
+
+        if (freed == 0) {
+            return false;
+        }
+
+        totalBytes -= freed;
+    }
+
+    return true;
+}
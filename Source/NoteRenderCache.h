@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    NoteRenderCache.h
+    Background thread that fills the per-note render cache of the current
+    HiSamplerSounds. Voices only flag the notes they'd like rendered, so the
+    audio thread never allocates or interpolates on behalf of the cache.
+    Renders across all the sounds share one memory budget; when it's exceeded,
+    the renders played longest ago are evicted first.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "HiSamplerVoice.h"
+
+//==============================================================================
+class NoteRenderCache : private Thread
+{
+public:
+    NoteRenderCache();
+    ~NoteRenderCache() override;
+
+    // Message thread: the sounds whose requested notes should be rendered.
+    void setSounds (const ReferenceCountedArray<HiSamplerSound>& newSounds);
+
+    // Any thread: takes effect the next time the thread renders something
+    void setMemoryBudget (int64 numBytes) noexcept { memoryBudget = numBytes; }
+    int64 getMemoryBudget() const noexcept { return memoryBudget; }
+
+private:
+    void run() override;
+    // Evicts until numBytesNeeded more would fit in the budget; returns false if they won't
+    bool makeRoom (const ReferenceCountedArray<HiSamplerSound>& current, int64 numBytesNeeded);
+
+    CriticalSection soundLock;
+    ReferenceCountedArray<HiSamplerSound> sounds;
+
+    static constexpr int pollIntervalMs = 10;
+
+    std::atomic<int64> memoryBudget { 64 * 1024 * 1024 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NoteRenderCache)
+};
@@ -18,57 +18,39 @@ HiSamplerAudioProcessorEditor::HiSamplerAudioProcessorEditor (HiSamplerAudioProc
     };
     addAndMakeVisible(loadButton);
     
-    Colour attackColour = Colours::cyan;
-    attackSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    attackSlider.setTextBoxStyle(Slider::TextBoxBelow, true, 40, 20);
-    attackSlider.setRange(0.0f, 2.0f, 0.01f);
-    // attackSlider.setValue(0.0);
-    attackSlider.setColour(Slider::ColourIds::thumbColourId, attackColour);
-    addAndMakeVisible(attackSlider);
-    attackLabel.setFont(10.f);
-    attackLabel.setText("Attack", NotificationType::dontSendNotification);
-    attackLabel.setColour(Label::ColourIds::textColourId, attackColour);
-    attackLabel.setJustificationType(Justification::centredTop);
-    attackLabel.attachToComponent(&attackSlider, false);
-    
-    Colour decayColour = Colours::yellow;
-    decaySlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    decaySlider.setTextBoxStyle(Slider::TextBoxBelow, true, 40, 20);
-    decaySlider.setRange(0.0f, 2.0f, 0.01f);
-    // decaySlider.setValue(0.0);
-    decaySlider.setColour(Slider::ColourIds::thumbColourId, decayColour);
-    addAndMakeVisible(decaySlider);
-    decayLabel.setFont(10.f);
-    decayLabel.setText("Decay", NotificationType::dontSendNotification);
-    decayLabel.setColour(Label::ColourIds::textColourId, decayColour);
-    decayLabel.setJustificationType(Justification::centredTop);
-    decayLabel.attachToComponent(&decaySlider, false);
-    
-    Colour sustainColour = Colours::magenta;
-    sustainSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    sustainSlider.setTextBoxStyle(Slider::TextBoxBelow, true, 40, 20);
-    sustainSlider.setRange(0.0f, 1.0f, 0.01f);
-    // sustainSlider.setValue(1.0);
-    sustainSlider.setColour(Slider::ColourIds::thumbColourId, sustainColour);
-    addAndMakeVisible(sustainSlider);
-    sustainLabel.setFont(10.f);
-    sustainLabel.setText("Sustain", NotificationType::dontSendNotification);
-    sustainLabel.setColour(Label::ColourIds::textColourId, sustainColour);
-    sustainLabel.setJustificationType(Justification::centredTop);
-    sustainLabel.attachToComponent(&sustainSlider, false);
-    
-    Colour releaseColour = Colours::white;
-    releaseSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
-    releaseSlider.setTextBoxStyle(Slider::TextBoxBelow, true, 40, 20);
-    releaseSlider.setRange(0.0f, 5.0f, 0.01f);
-    // releaseSlider.setValue(0.0);
-    releaseSlider.setColour(Slider::ColourIds::thumbColourId, releaseColour);
-    addAndMakeVisible(releaseSlider);
-    releaseLabel.setFont(10.f);
-    releaseLabel.setText("Release", NotificationType::dontSendNotification);
-    releaseLabel.setColour(Label::ColourIds::textColourId, releaseColour);
-    releaseLabel.setJustificationType(Justification::centredTop);
-    releaseLabel.attachToComponent(&releaseSlider, false);
+    recordButton.setClickingTogglesState(true);
+    recordButton.setToggleState(audioProcessor.isRecording(), NotificationType::dontSendNotification);
+    recordButton.setColour(TextButton::ColourIds::buttonOnColourId, Colours::red);
+    recordButton.onClick = [&] {
+        if (recordButton.getToggleState()) {
+            if (! audioProcessor.startRecording()) {
+                recordButton.setToggleState(false, NotificationType::dontSendNotification);
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Can't record",
+                                                 "hiSampler records from its sidechain input, which isn't connected. "
+                                                 "Switch the sidechain on in your host and start playback, then try again.");
+            }
+        }
+        else {
+            audioProcessor.stopRecording();
+        }
+    };
+    addAndMakeVisible(recordButton);
+    
+    impulseButton.onClick = [&] {
+        audioProcessor.loadImpulseResponse();
+    };
+    addAndMakeVisible(impulseButton);
+    
+    programsButton.onClick = [&] {
+        audioProcessor.loadProgramFolder();
+    };
+    addAndMakeVisible(programsButton);
+    
+    // the attachments below set each dial's range from its parameter
+    setUpDial(attackSlider, attackLabel, "Attack", Colours::cyan);
+    setUpDial(decaySlider, decayLabel, "Decay", Colours::yellow);
+    setUpDial(sustainSlider, sustainLabel, "Sustain", Colours::magenta);
+    setUpDial(releaseSlider, releaseLabel, "Release", Colours::white);
     
     /*
     audioProcessor.getADSRParams().attack = 0.0;
@@ -84,10 +66,26 @@ HiSamplerAudioProcessorEditor::HiSamplerAudioProcessorEditor (HiSamplerAudioProc
     
     
     setSize (600, 200);
+    
+    // programs can change from MIDI and the view from automation, so redraw the waveform when they do
+    startTimerHz(30);
 }
 
 HiSamplerAudioProcessorEditor::~HiSamplerAudioProcessorEditor() {}
 
+void HiSamplerAudioProcessorEditor::setUpDial (Slider& slider, Label& label, const String& name, Colour colour) {
+    slider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
+    slider.setTextBoxStyle(Slider::TextBoxBelow, true, 40, 20);
+    slider.setColour(Slider::ColourIds::thumbColourId, colour);
+    addAndMakeVisible(slider);
+    
+    label.setFont(10.f);
+    label.setText(name, NotificationType::dontSendNotification);
+    label.setColour(Label::ColourIds::textColourId, colour);
+    label.setJustificationType(Justification::centredTop);
+    label.attachToComponent(&slider, false);
+}
+
 //==============================================================================
 void HiSamplerAudioProcessorEditor::paint (juce::Graphics& g) {
     g.fillAll(Colours::black);
@@ -99,12 +97,18 @@ void HiSamplerAudioProcessorEditor::paint (juce::Graphics& g) {
         audioPoints.clear();
         
         AudioBuffer<float>& waveform = audioProcessor.getWaveform();
-        auto ratio = waveform.getNumSamples() / getWidth();
+        auto view = audioProcessor.getSampleView();
+        auto range = audioProcessor.getPlaybackRange();
+        auto start = range.getStart();
+        auto end = range.getEnd();
+        auto level = view.getLevel(audioProcessor.getSamplePeak());
+        auto ratio = jmax(1, (end - start) / getWidth());
         auto buffer = waveform.getReadPointer(0);
         
-        // scale audio file to window on x axis
-        for (int sample = 0; sample < waveform.getNumSamples(); sample += ratio) {
-            audioPoints.push_back(buffer[sample]);
+        // scale the trimmed region to window on x axis, applying the view as we read
+        for (int sample = 0; sample < end - start; sample += ratio) {
+            auto index = view.reversed ? end - 1 - sample : start + sample;
+            audioPoints.push_back(buffer[index] * level);
         }
         
         p.startNewSubPath(0, getHeight() / 2);
@@ -126,12 +130,29 @@ void HiSamplerAudioProcessorEditor::resized() {
     const float dialWidth = 0.1f;
     const float dialHeight = 0.4f;
     
+    recordButton.setBoundsRelative(0.85f, 0.05f, 0.13f, 0.12f);
+    impulseButton.setBoundsRelative(0.85f, 0.2f, 0.13f, 0.12f);
+    programsButton.setBoundsRelative(0.85f, 0.35f, 0.13f, 0.12f);
+    
     attackSlider.setBoundsRelative(startX, startY, dialWidth, dialHeight);
     decaySlider.setBoundsRelative(startX + dialWidth, startY, dialWidth, dialHeight);
     sustainSlider.setBoundsRelative(startX + 2 * dialWidth, startY, dialWidth, dialHeight);
     releaseSlider.setBoundsRelative(startX + 3 * dialWidth, startY, dialWidth, dialHeight);
 }
 
+void HiSamplerAudioProcessorEditor::timerCallback() {
+    // a take can also stop without the button, when the host re-prepares us
+    recordButton.setToggleState(audioProcessor.isRecording(), NotificationType::dontSendNotification);
+    
+    auto view = audioProcessor.getSampleView();
+    
+    if (audioProcessor.getWaveformVersion() != waveformVersion || view != paintedView) {
+        waveformVersion = audioProcessor.getWaveformVersion();
+        paintedView = view;
+        repaint();
+    }
+}
+
 bool HiSamplerAudioProcessorEditor::isInterestedInFileDrag (const StringArray& files) {
     for (auto file : files) {
         if (file.contains(".wav") || file.contains(".mp3") || file.contains(".aif")) {
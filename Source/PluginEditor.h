@@ -13,7 +13,8 @@
 
 //==============================================================================
 class HiSamplerAudioProcessorEditor   : public juce::AudioProcessorEditor,
-                                        public FileDragAndDropTarget
+                                        public FileDragAndDropTarget,
+                                        private Timer
 {
 public:
     HiSamplerAudioProcessorEditor (HiSamplerAudioProcessor&);
@@ -28,6 +29,14 @@ public:
     
 private:
     TextButton loadButton { "Load a sample!" };
+    TextButton recordButton { "Record" };
+    TextButton impulseButton { "Load IR" };
+    TextButton programsButton { "Programs" };
+    int waveformVersion { 0 };
+    SampleView paintedView;     // repaint when the trims, direction or level change
+    
+    void timerCallback() override;
+    void setUpDial (Slider& slider, Label& label, const String& name, Colour colour);
     std::vector<float> audioPoints;
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
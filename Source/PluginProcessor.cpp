@@ -16,21 +16,63 @@ HiSamplerAudioProcessor::HiSamplerAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  AudioChannelSet::stereo(), true)
+                      #else
+                       .withInput  ("Input",  AudioChannelSet::stereo(), false)
+                       .withInput  ("Sidechain", AudioChannelSet::stereo(), true) // only feeds the recorder
                       #endif
                        .withOutput ("Output", AudioChannelSet::stereo(), true)
                      #endif
                        ), apvts (*this, nullptr, "PARAMETERS", createParameters())
 #endif
 {
-    formatManager.registerBasicFormats();
+    attackParam = apvts.getRawParameterValue("ATTACK");
+    decayParam = apvts.getRawParameterValue("DECAY");
+    sustainParam = apvts.getRawParameterValue("SUSTAIN");
+    releaseParam = apvts.getRawParameterValue("RELEASE");
+    startParam = apvts.getRawParameterValue("START");
+    endParam = apvts.getRawParameterValue("END");
+    reverseParam = apvts.getRawParameterValue("REVERSE");
+    gainParam = apvts.getRawParameterValue("GAIN");
+    normalizeParam = apvts.getRawParameterValue("NORMALIZE");
+    reverbParam = apvts.getRawParameterValue("REVERB");
+    renderQuantumParam = apvts.getRawParameterValue("RENDER_QUANTUM");
+    
     apvts.state.addListener(this);
-    for (int i = 0; i < numVoices; i++) {
-        sampler.addVoice (new SamplerVoice());
+    
+    sampleRecorder.onRecordingFinished = [this] (SampleRecorder::Take&& take) {
+        recordingFinished(std::move(take));
+    };
+    
+    reverb.onImpulseResponseChanged = [this] {
+        triggerAsyncUpdate();
+    };
+    
+    sampleProgram = new ProgramBank("Sample", getEnvelopeFromParameters());
+    sampler.addProgram(sampleProgram);
+    displayedProgram = sampleProgram.get();
+    envelopeProgram = sampleProgram.get();
+    
+    for (auto* parameterID : { "ATTACK", "DECAY", "SUSTAIN", "RELEASE" }) {
+        apvts.addParameterListener(parameterID, this);
     }
+    
+    programLoader.onProgramLoaded = [this] (ProgramBank::Ptr bank) {
+        {
+            const ScopedLock sl (loadedProgramsLock);
+            loadedPrograms.add(bank);
+        }
+        
+        triggerAsyncUpdate();
+    };
+    
+    // voices, threads and timers are all left until something needs them, since hosts
+    // may open a hundred instances at once
+    StartupBenchmark::runOnceAfterStartup();
 }
 
 HiSamplerAudioProcessor::~HiSamplerAudioProcessor() {
-    formatReader = nullptr;
+    stopTimer();
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -63,33 +105,64 @@ bool HiSamplerAudioProcessor::isMidiEffect() const {
 }
 
 double HiSamplerAudioProcessor::getTailLengthSeconds() const {
-    return 0.0;
+    return reverb.getTailLengthSeconds();
 }
 
 int HiSamplerAudioProcessor::getNumPrograms() {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    // some wrappers (VST3) only ask once, so every MIDI program number is a slot from the start;
+    // slots without a bank yet are named as such, and selecting one does nothing
+    return ProgramSynthesiser::maxPrograms;
 }
 
 int HiSamplerAudioProcessor::getCurrentProgram() {
-    return 0;
+    return sampler.getSelectedProgramIndex();
 }
 
 void HiSamplerAudioProcessor::setCurrentProgram (int index) {
+    // hosts may call this from any thread, so this only flips the program; the timer does the rest
+    sampler.selectProgram(index);
 }
 
 const String HiSamplerAudioProcessor::getProgramName (int index) {
-    return {};
+    if (auto* program = sampler.getProgram(index)) {
+        return program->getName();
+    }
+    return "Empty";
 }
 
 void HiSamplerAudioProcessor::changeProgramName (int index, const String& newName) {
+    if (auto* program = sampler.getProgram(index)) {
+        program->setName(newName);
+    }
 }
 
 //==============================================================================
 void HiSamplerAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    // instances that are never played never pay for their voices
+    if (sampler.getNumVoices() == 0) {
+        for (int i = 0; i < numVoices; i++) {
+            sampler.addVoice (new HiSamplerVoice());
+        }
+    }
+    
     sampler.setCurrentPlaybackSampleRate(sampleRate);
+    
+    // the audio callback isn't running here, so it's safe to drop renders made for the old rate
+    for (int i = 0; i < sampler.getNumSounds(); i++) {
+        if (auto sound = dynamic_cast<HiSamplerSound*>(sampler.getSound(i).get())) {
+            sound->setRenderSampleRate(sampleRate);
+        }
+    }
+    
     updateADSR();
+    updateSampleView();
+    
+    sampleRecorder.prepare(sampleRate, getChannelCountOfBus(true, sidechainBus));
+    reverb.prepare(sampleRate, samplesPerBlock);
+    
+    // room for plenty of events, so splitting MIDI into chunks never allocates
+    chunkMidi.ensureSize(4096);
 }
 
 void HiSamplerAudioProcessor::releaseResources() {
@@ -115,6 +188,14 @@ bool HiSamplerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+   #else
+    // Either input can be switched off, or be mono or stereo; only the sidechain is recorded
+    for (int bus = 0; bus < layouts.inputBuses.size(); ++bus) {
+        auto set = layouts.getChannelSet(true, bus);
+        
+        if (! set.isDisabled() && set != AudioChannelSet::mono() && set != AudioChannelSet::stereo())
+            return false;
+    }
    #endif
 
     return true;
@@ -123,19 +204,61 @@ bool HiSamplerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 #endif
 
 void HiSamplerAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) {
+    RealtimeSafetyChecker::ScopedAudioCallback realtimeCheck;
     ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     
+   #if JucePlugin_IsSynth
+    if (getChannelCountOfBus(true, sidechainBus) > 0) {
+        sampleRecorder.pushInput(getBusBuffer(buffer, true, sidechainBus), buffer.getNumSamples());
+    }
+    
+    // the inputs only feed the recorder, so none of them should be heard
+    buffer.clear();
+    ignoreUnused (totalNumInputChannels, totalNumOutputChannels);
+   #else
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i) {
         buffer.clear (i, 0, buffer.getNumSamples());
     }
+   #endif
+    
+    auto quantum = getRenderQuantum();
+    
+    if (quantum != appliedRenderQuantum) {
+        // with a quantum, MIDI events land on chunk boundaries so every voice renders whole chunks.
+        // The cost is timing: strict subdivision moves each event to the start of its chunk,
+        // so notes can start up to quantum - 1 samples early.
+        sampler.setMinimumRenderingSubdivisionSize(quantum > 0 ? quantum : 32, quantum > 0);
+        appliedRenderQuantum = quantum;
+    }
+    
+    if (quantum <= 0 || quantum >= buffer.getNumSamples()) {
+        renderChunk(buffer, midiMessages);
+        return;
+    }
     
-    if (shouldUpdate) {
+    // split the host block into fixed chunks, so the working set doesn't grow with the host's buffer size
+    for (int offset = 0; offset < buffer.getNumSamples(); offset += quantum) {
+        auto numSamples = jmin(quantum, buffer.getNumSamples() - offset);
+        AudioBuffer<float> chunk (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), offset, numSamples);
+        
+        chunkMidi.clear();
+        chunkMidi.addEvents(midiMessages, offset, numSamples, -offset);
+        
+        renderChunk(chunk, chunkMidi);
+    }
+}
+
+void HiSamplerAudioProcessor::renderChunk (AudioBuffer<float>& chunk, MidiBuffer& midiMessages) {
+    // parameter changes are picked up at chunk boundaries
+    if (shouldUpdate.exchange(false)) {
         updateADSR();
+        updateSampleView();
     }
     
-    sampler.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
+    sampler.renderNextBlock(chunk, midiMessages, 0, chunk.getNumSamples());
+    reverb.process(chunk, reverbParam->load());
 }
 
 //==============================================================================
@@ -149,66 +272,454 @@ AudioProcessorEditor* HiSamplerAudioProcessor::createEditor() {
 
 //==============================================================================
 void HiSamplerAudioProcessor::getStateInformation (MemoryBlock& destData) {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    auto state = apvts.copyState();
+    
+    // program 0 is whatever sample was loaded or recorded, so only the banks are saved
+    ValueTree programs ("PROGRAMS");
+    programs.setProperty("selected", sampler.getSelectedProgramIndex(), nullptr);
+    
+    for (int i = 1; i < sampler.getNumPrograms(); ++i) {
+        auto* bank = sampler.getProgram(i);
+        auto description = bank->getDescription();
+        auto envelope = bank == envelopeProgram.load() ? withMovedKnobs(description.envelope) : description.envelope;
+        
+        ValueTree program ("PROGRAM");
+        program.setProperty("name", description.name, nullptr);
+        program.setProperty("attack", envelope.attack, nullptr);
+        program.setProperty("decay", envelope.decay, nullptr);
+        program.setProperty("sustain", envelope.sustain, nullptr);
+        program.setProperty("release", envelope.release, nullptr);
+        
+        for (auto& zone : description.zones) {
+            ValueTree zoneState ("ZONE");
+            zoneState.setProperty("file", zone.file.getFullPathName(), nullptr);
+            zoneState.setProperty("notes", zone.midiNotes.toString(16), nullptr);
+            zoneState.setProperty("root", zone.midiRootNote, nullptr);
+            program.appendChild(zoneState, nullptr);
+        }
+        
+        programs.appendChild(program, nullptr);
+    }
+    
+    state.appendChild(programs, nullptr);
+    
+    std::unique_ptr<XmlElement> xml (state.createXml());
+    copyXmlToBinary(*xml, destData);
 }
 
 void HiSamplerAudioProcessor::setStateInformation (const void* data, int sizeInBytes) {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    std::unique_ptr<XmlElement> xml (getXmlFromBinary(data, sizeInBytes));
+    
+    if (xml == nullptr || ! xml->hasTagName(apvts.state.getType())) {
+        return;
+    }
+    
+    auto state = ValueTree::fromXml(*xml);
+    auto programs = state.getChildWithName("PROGRAMS");
+    state.removeChild(programs, nullptr);
+    apvts.replaceState(state);
+    
+    // the saved banks replace the current ones, including any still being decoded
+    programLoader.cancelPending();
+    
+    {
+        const ScopedLock sl (loadedProgramsLock);
+        loadedPrograms.clear();
+    }
+    
+    sampler.clearPrograms(releasePool);
+    refreshRenderCache();
+    
+    // as in a new instance, the knobs start out as the sample program's envelope
+    sampleProgram->setEnvelope(getEnvelopeFromParameters());
+    envelopeProgram = sampleProgram.get();
+    movedEnvelopeKnobs = allEnvelopeKnobs;
+    shouldUpdate = true;
+    
+    // the knobs are on the sample program already, so this only moves the editor off a retired bank
+    syncToSelectedProgram();
+    
+    // the banks are decoded in the background again, and come back in the order they were saved,
+    // so each one gets its old program number back
+    for (auto program : programs) {
+        ProgramBank::Description description;
+        description.name = program["name"].toString();
+        description.envelope.attack = program["attack"];
+        description.envelope.decay = program["decay"];
+        description.envelope.sustain = program["sustain"];
+        description.envelope.release = program["release"];
+        
+        for (auto zoneState : program) {
+            ProgramBank::Zone zone;
+            zone.file = File (zoneState["file"].toString());
+            zone.midiNotes.parseString(zoneState["notes"].toString(), 16);
+            zone.midiRootNote = zoneState["root"];
+            description.zones.add(zone);
+        }
+        
+        addProgram(description);
+    }
+    
+    int selected = programs.getProperty("selected", 0);
+    pendingProgramSelection = selected > 0 ? selected : -1;
 }
 
 void HiSamplerAudioProcessor::loadFile() {
-    sampler.clearSounds();
-    
     FileChooser chooser {"Please load a file!"};
     if (chooser.browseForFileToOpen()) {
-        File file = chooser.getResult();
-        formatReader = formatManager.createReaderFor(file);
+        loadFile(chooser.getResult().getFullPathName());
     }
-    BigInteger range;
-    range.setRange(0, 128, true);
-    sampler.addSound(new SamplerSound("Sample", // const String &name
-                                      *formatReader, // AudioFormatReader &source
-                                      range, // const BigInteger &midinotes
-                                      60, // int midiNoteForNormalPitch
-                                      0.001, // double attackTimeSecs
-                                      0.001, // double releaseTimeSecs
-                                      10.0)); // double maxSampleLengthSeconds
 }
 
 void HiSamplerAudioProcessor::loadFile(const String& path) {
-    sampler.clearSounds();
-    
     File file = File (path);
-    formatReader = formatManager.createReaderFor(file);
+    std::unique_ptr<AudioFormatReader> formatReader (formatManager->createReaderFor(file));
+    
+    // a file we can't decode leaves the current sample playing
+    if (formatReader == nullptr || formatReader->lengthInSamples <= 0) {
+        return;
+    }
     
-    auto sampleLength = static_cast<int>(formatReader->lengthInSamples);
+    BigInteger range;
+    range.setRange(0, 128, true);
+    HiSamplerSound::Ptr sound = new HiSamplerSound("Sample", // const String &name
+                                                   *formatReader, // AudioFormatReader &source
+                                                   range, // const BigInteger &midinotes
+                                                   60, // int midiNoteForNormalPitch
+                                                   0.001, // double attackTimeSecs
+                                                   0.001, // double releaseTimeSecs
+                                                   10.0); // double maxSampleLengthSeconds
     
-    waveform.setSize(1, sampleLength);
-    formatReader->read(&waveform, 0, sampleLength, 0, true, false);
+    // only as much as the sound kept, so the display trims the same samples the voices do
+    auto sampleLength = sound->getLength();
+    AudioBuffer<float> sampleWaveform (1, sampleLength);
+    formatReader->read(&sampleWaveform, 0, sampleLength, 0, true, false);
+    
+    addSampleSound(sound, std::move(sampleWaveform));
+}
+
+void HiSamplerAudioProcessor::loadImpulseResponse() {
+    FileChooser chooser {"Please load an impulse response!"};
+    if (chooser.browseForFileToOpen()) {
+        loadImpulseResponse(chooser.getResult().getFullPathName());
+    }
+}
+
+void HiSamplerAudioProcessor::loadImpulseResponse(const String& path) {
+    // the latency changes in handleAsyncUpdate, once the reverb is actually using it
+    reverb.loadImpulseResponse(File (path), *formatManager);
+}
+
+void HiSamplerAudioProcessor::addProgram(const ProgramBank::Description& description) {
+    programLoader.load(description);
+}
+
+void HiSamplerAudioProcessor::loadProgramFolder() {
+    FileChooser chooser {"Please choose a folder of samples!"};
+    if (chooser.browseForDirectory()) {
+        loadProgramFolder(chooser.getResult());
+    }
+}
+
+void HiSamplerAudioProcessor::loadProgramFolder(const File& folder) {
+    auto files = folder.findChildFiles(File::findFiles, false, formatManager->getWildcardForAllFormats());
+    files.sort();
     
     BigInteger range;
     range.setRange(0, 128, true);
-    sampler.addSound(new SamplerSound("Sample", // const String &name
-                                      *formatReader, // AudioFormatReader &source
-                                      range, // const BigInteger &midinotes
-                                      60, // int midiNoteForNormalPitch
-                                      0.001, // double attackTimeSecs
-                                      0.001, // double releaseTimeSecs
-                                      10.0)); // double maxSampleLengthSeconds
+    
+    // each sample becomes a program across the whole keyboard, starting with the current envelope
+    for (auto& file : files) {
+        ProgramBank::Description description;
+        description.name = file.getFileNameWithoutExtension();
+        description.zones.add({ file, range, 60 });
+        description.envelope = getEnvelopeFromParameters();
+        addProgram(description);
+    }
+}
+
+bool HiSamplerAudioProcessor::startRecording() {
+    return sampleRecorder.startRecording();
+}
+
+void HiSamplerAudioProcessor::stopRecording() {
+    sampleRecorder.stopRecording();
+}
+
+void HiSamplerAudioProcessor::recordingFinished (SampleRecorder::Take&& take) {
+    // we're on the recorder thread, so build the sound and its waveform here,
+    // then let the message thread swap them in
+    AudioBuffer<float> takeWaveform (1, take.length);
+    takeWaveform.copyFrom(0, 0, *take.data, 0, 0, take.length);
+    
+    BigInteger range;
+    range.setRange(0, 128, true);
+    HiSamplerSound::Ptr sound = new HiSamplerSound("Recording", // const String &name
+                                                   *take.data, // const AudioBuffer<float>& sourceData
+                                                   take.length, // int length
+                                                   take.sampleRate, // double sourceSampleRate
+                                                   range, // const BigInteger &midinotes
+                                                   60, // int midiNoteForNormalPitch
+                                                   0.001, // double attackTimeSecs
+                                                   0.001); // double releaseTimeSecs
+    
+    {
+        const ScopedLock sl (recordedSoundLock);
+        recordedSound = sound;
+        recordedWaveform = std::move(takeWaveform);
+    }
+    
+    triggerAsyncUpdate();
+}
+
+void HiSamplerAudioProcessor::handleAsyncUpdate() {
+    HiSamplerSound::Ptr sound;
+    AudioBuffer<float> takeWaveform;
+    
+    {
+        const ScopedLock sl (recordedSoundLock);
+        sound = std::move(recordedSound);
+        takeWaveform = std::move(recordedWaveform);
+    }
+    
+    if (sound != nullptr) {
+        addSampleSound(sound, std::move(takeWaveform));
+        updateADSR();
+    }
+    
+    addLoadedPrograms();
+    
+    // the reverb works in fixed blocks, so with an impulse response everything comes out one block late
+    setLatencySamples(reverb.hasImpulseResponse() ? ConvolutionReverb::blockSize : 0);
+}
+
+void HiSamplerAudioProcessor::addSampleSound(HiSamplerSound::Ptr sound, AudioBuffer<float>&& sampleWaveform) {
+    sound->setView(getSampleView());
+    sound->setRenderSampleRate(getSampleRate());
+    sound->setRenderCacheEnabled(noteCacheEnabled);
+    
+    // the new sound starts with the sample program's envelope, so bring that up to date first
+    if (envelopeProgram == sampleProgram.get()) {
+        sampleProgram->setEnvelope(withMovedKnobs(sampleProgram->getEnvelope()));
+    }
+    
+    auto peak = sound->getPeak();
+    releasePool.add(sound.get());
+    
+    // only now that the new sound exists does the old one go
+    sampler.clearProgramSounds(*sampleProgram);
+    sampler.addProgramSound(*sampleProgram, sound);
+    sampleProgram->setWaveform(std::move(sampleWaveform), peak);
+    refreshRenderCache();
+    
+    // a new sample is what you want to hear next
+    sampler.selectProgram(0);
+    syncToSelectedProgram();
+}
+
+void HiSamplerAudioProcessor::addLoadedPrograms() {
+    ReferenceCountedArray<ProgramBank> programs;
+    
+    {
+        const ScopedLock sl (loadedProgramsLock);
+        programs.swapWith(loadedPrograms);
+    }
+    
+    if (programs.isEmpty()) {
+        return;
+    }
+    
+    auto view = getSampleView();
+    
+    for (auto* program : programs) {
+        for (auto* sound : program->getSounds()) {
+            sound->setView(view);
+            sound->setRenderSampleRate(getSampleRate());
+            sound->setRenderCacheEnabled(noteCacheEnabled);
+            releasePool.add(sound);
+        }
+        
+        // past 128 programs there's no MIDI program number left, so the bank is dropped
+        sampler.addProgram(program);
+    }
+    
+    // a restored session goes back to its program once the bank has loaded
+    if (pendingProgramSelection > 0 && pendingProgramSelection < sampler.getNumPrograms()) {
+        sampler.selectProgram(pendingProgramSelection);
+        pendingProgramSelection = -1;
+    }
+    
+    refreshRenderCache();
+    updateHostDisplay();
+    
+    // MIDI program changes happen on the audio thread, so the editor catches up from here
+    if (! isTimerRunning()) {
+        startTimerHz(30);
+    }
+}
+
+void HiSamplerAudioProcessor::refreshRenderCache() {
+    ReferenceCountedArray<HiSamplerSound> sounds;
+    
+    for (int i = 0; i < sampler.getNumSounds(); i++) {
+        if (auto sound = dynamic_cast<HiSamplerSound*>(sampler.getSound(i).get())) {
+            sounds.add(sound);
+        }
+    }
+    
+    noteRenderCache.setSounds(sounds);
+}
+
+ADSR::Parameters HiSamplerAudioProcessor::getEnvelopeFromParameters() const {
+    ADSR::Parameters envelope;
+    envelope.attack = attackParam->load();
+    envelope.decay = decayParam->load();
+    envelope.sustain = sustainParam->load();
+    envelope.release = releaseParam->load();
+    return envelope;
+}
+
+void HiSamplerAudioProcessor::syncToSelectedProgram() {
+    auto* program = sampler.getSelectedProgram();
+    
+    if (program == nullptr) {
+        return;
+    }
+    
+    displayedProgram = program;
+    waveform = program->getWaveform();
+    samplePeak = program->getPeak();
+    ++waveformVersion;
+    
+    // the program the knobs were on keeps what they changed, and the new one plays its own
+    // envelope until a knob is turned; the knobs themselves stay put, so the host sees no automation
+    auto* knobProgram = envelopeProgram.load();
+    
+    if (knobProgram != nullptr && knobProgram != program) {
+        knobProgram->setEnvelope(withMovedKnobs(knobProgram->getEnvelope()));
+        envelopeProgram = nullptr;
+        movedEnvelopeKnobs = 0;
+    }
+    
+    updateHostDisplay();
+}
+
+void HiSamplerAudioProcessor::timerCallback() {
+    if (sampler.getSelectedProgram() != displayedProgram) {
+        syncToSelectedProgram();
+    }
 }
 
 void HiSamplerAudioProcessor::updateADSR() {
-    ADSRParams.attack = apvts.getRawParameterValue("ATTACK")->load(); // uses std::atomic
-    ADSRParams.decay = apvts.getRawParameterValue("DECAY")->load();
-    ADSRParams.sustain = apvts.getRawParameterValue("SUSTAIN")->load();
-    ADSRParams.release = apvts.getRawParameterValue("RELEASE")->load();
+    ADSRParams = getEnvelopeFromParameters(); // uses std::atomic
+    
+    // the knobs only edit the stages they moved, of the program they were turned on
+    auto* program = envelopeProgram.load();
+    
+    if (program == nullptr) {
+        return;
+    }
+    
+    // the message thread adds and removes sounds under this lock, and renderNextBlock takes it anyway
+    const ScopedLock sl (sampler.getLock());
+    
+    for (int i = 0; i < sampler.getNumSounds(); i++) {
+        if (auto sound = dynamic_cast<HiSamplerSound*>(sampler.getSound(i).get())) { // dynamic casting to make sure we're working with a sampler sound, NOT a synthesizer sound
+            if (sound->getProgram() == program) {
+                sound->setEnvelopeParameters(withMovedKnobs(sound->getEnvelopeParameters()));
+            }
+        }
+    }
+}
+
+ADSR::Parameters HiSamplerAudioProcessor::withMovedKnobs (ADSR::Parameters envelope) const {
+    auto moved = movedEnvelopeKnobs.load();
+    
+    if (moved & attackKnob) {
+        envelope.attack = attackParam->load();
+    }
+    if (moved & decayKnob) {
+        envelope.decay = decayParam->load();
+    }
+    if (moved & sustainKnob) {
+        envelope.sustain = sustainParam->load();
+    }
+    if (moved & releaseKnob) {
+        envelope.release = releaseParam->load();
+    }
+    
+    return envelope;
+}
+
+void HiSamplerAudioProcessor::parameterChanged (const String& parameterID, float /*newValue*/) {
+    // any thread, including the audio thread: a turned knob takes over that stage of the selected program
+    auto knob = parameterID == "ATTACK" ? attackKnob
+              : parameterID == "DECAY" ? decayKnob
+              : parameterID == "SUSTAIN" ? sustainKnob
+              : releaseKnob;
+    
+    auto* selected = sampler.getSelectedProgram();
+    
+    if (envelopeProgram.exchange(selected) != selected) {
+        movedEnvelopeKnobs = 0;
+    }
+    
+    movedEnvelopeKnobs |= knob;
+    shouldUpdate = true;
+}
+
+void HiSamplerAudioProcessor::setRenderQuantum (int numSamples) {
+    // the choices are Off, 32, 64 and 128
+    auto choice = numSamples >= 128 ? 3 : numSamples >= 64 ? 2 : numSamples > 0 ? 1 : 0;
+    auto* parameter = apvts.getParameter("RENDER_QUANTUM");
+    parameter->setValueNotifyingHost(parameter->convertTo0to1((float) choice));
+}
+
+int HiSamplerAudioProcessor::getRenderQuantum() const {
+    auto choice = roundToInt(renderQuantumParam->load());
+    return choice > 0 ? 16 << choice : 0;
+}
+
+SampleView HiSamplerAudioProcessor::getSampleView() const {
+    SampleView view;
+    view.start = startParam->load();
+    view.end = endParam->load();
+    view.reversed = reverseParam->load() > 0.5f;
+    view.gain = Decibels::decibelsToGain(gainParam->load());
+    view.normalize = normalizeParam->load() > 0.5f;
+    return view;
+}
+
+Range<int> HiSamplerAudioProcessor::getPlaybackRange() const {
+    // the displayed waveform is the program's first sound, so its trims are what we see
+    if (displayedProgram != nullptr && ! displayedProgram->getSounds().isEmpty()) {
+        auto range = displayedProgram->getSounds().getFirst()->getPlaybackRange(getSampleView());
+        return range.getIntersectionWith({ 0, waveform.getNumSamples() });
+    }
+    
+    auto view = getSampleView();
+    return { view.getStartSample(waveform.getNumSamples()), view.getEndSample(waveform.getNumSamples()) };
+}
+
+void HiSamplerAudioProcessor::updateSampleView() {
+    auto view = getSampleView();
+    
+    // as in updateADSR, the sound list may be changing on the message thread
+    const ScopedLock sl (sampler.getLock());
     
     for (int i = 0; i < sampler.getNumSounds(); i++) {
-        if (auto sound = dynamic_cast<SamplerSound*>(sampler.getSound(i).get())) { // dynamic casting to make sure we're working with a sampler sound, NOT a synthesizer sound
-            sound->setEnvelopeParameters(ADSRParams);
+        if (auto sound = dynamic_cast<HiSamplerSound*>(sampler.getSound(i).get())) {
+            sound->setView(view);
+        }
+    }
+}
+
+void HiSamplerAudioProcessor::setNoteCacheEnabled (bool shouldBeEnabled) {
+    noteCacheEnabled = shouldBeEnabled;
+    
+    for (int i = 0; i < sampler.getNumSounds(); i++) {
+        if (auto sound = dynamic_cast<HiSamplerSound*>(sampler.getSound(i).get())) {
+            sound->setRenderCacheEnabled(shouldBeEnabled);
         }
     }
 }
@@ -226,6 +737,16 @@ AudioProcessorValueTreeState::ParameterLayout HiSamplerAudioProcessor::createPar
     parameters.push_back (std::make_unique<AudioParameterFloat>("DECAY", "Decay", 0.0f, 2.0f, 0.0f));
     parameters.push_back (std::make_unique<AudioParameterFloat>("SUSTAIN", "Sustain", 0.0f, 1.0f, 1.0f));
     parameters.push_back (std::make_unique<AudioParameterFloat>("RELEASE", "Release", 0.0f, 5.0f, 0.0f));
+    
+    parameters.push_back (std::make_unique<AudioParameterFloat>("START", "Start", 0.0f, 1.0f, 0.0f));
+    parameters.push_back (std::make_unique<AudioParameterFloat>("END", "End", 0.0f, 1.0f, 1.0f));
+    parameters.push_back (std::make_unique<AudioParameterBool>("REVERSE", "Reverse", false));
+    parameters.push_back (std::make_unique<AudioParameterFloat>("GAIN", "Gain", -24.0f, 24.0f, 0.0f));
+    parameters.push_back (std::make_unique<AudioParameterBool>("NORMALIZE", "Normalize", false));
+    
+    parameters.push_back (std::make_unique<AudioParameterFloat>("REVERB", "Reverb", 0.0f, 1.0f, 0.3f));
+    
+    parameters.push_back (std::make_unique<AudioParameterChoice>("RENDER_QUANTUM", "Render Quantum", StringArray { "Off", "32", "64", "128" }, 0));
 
     return { parameters.begin(), parameters.end() };
 }
@@ -9,11 +9,23 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "HiSamplerVoice.h"
+#include "NoteRenderCache.h"
+#include "RealtimeSafetyChecker.h"
+#include "SampleRecorder.h"
+#include "ConvolutionReverb.h"
+#include "ProgramSynthesiser.h"
+#include "ReleasePool.h"
+#include "SharedAudioFormatManager.h"
+#include "StartupBenchmark.h"
 
 //==============================================================================
 
 class HiSamplerAudioProcessor : public AudioProcessor,
-                                public ValueTree::Listener
+                                public ValueTree::Listener,
+                                private AudioProcessorValueTreeState::Listener,
+                                private AsyncUpdater,
+                                private Timer
 {
 public:
     //==============================================================================
@@ -57,29 +69,136 @@ public:
     void loadFile();
     void loadFile(const String& path);
     
+    // Records the sidechain input; when stopped, the take replaces the current sample.
+    // Returns false if there's nothing to record from, e.g. the host has the sidechain switched off.
+    bool startRecording();
+    void stopRecording();
+    bool isRecording() const { return sampleRecorder.isRecording(); }
+    
+    // Loads an impulse response for the built-in convolution reverb, in the background
+    void loadImpulseResponse();
+    void loadImpulseResponse(const String& path);
+    
+    // Program 0 is the loaded or recorded sample; the others are banks decoded in the
+    // background and then switched instantly, by the host or by MIDI program change.
+    // Banks are saved with the session, as the files they were decoded from.
+    void addProgram(const ProgramBank::Description& description);
+    void loadProgramFolder();
+    void loadProgramFolder(const File& folder);
+    
     int getNumSamplerSounds() { return sampler.getNumSounds(); }
     AudioBuffer<float>& getWaveform() { return waveform; }
+    int getWaveformVersion() const { return waveformVersion; } // bumped whenever the waveform changes
     
     void updateADSR();
     ADSR::Parameters& getADSRParams() { return ADSRParams; }
     
+    // Trim/reverse/gain/normalize edits, read straight from the parameters
+    SampleView getSampleView() const;
+    // The part of the displayed waveform that voices play with the current view
+    Range<int> getPlaybackRange() const;
+    void updateSampleView();
+    float getSamplePeak() const { return samplePeak; }
+    
+    // Pre-renders each note the first time it's hit, so repeated one-shots skip interpolation
+    void setNoteCacheEnabled (bool shouldBeEnabled);
+    bool isNoteCacheEnabled() const { return noteCacheEnabled; }
+    
+    // Renders in fixed chunks of 32/64/128 samples whatever the host's block size (0 = off).
+    // This is the RENDER_QUANTUM parameter, so it's automatable and saved with the session.
+    void setRenderQuantum (int numSamples);
+    int getRenderQuantum() const;
+    
+    // Locks sample memory loaded from now on into RAM (off by default)
+    void setSampleMemoryLocked (bool shouldLock) { SampleMemoryArena::setLockingEnabled (shouldLock); }
+    SampleMemoryArena::Stats getSampleMemoryStats() const { return SampleMemoryArena::getStats(); }
+    
     AudioProcessorValueTreeState& getAPVTS() { return apvts; }
     
     
 private:
     
-    Synthesiser sampler;
+    // shared by every instance, and declared first so it outlives the threads that read files
+    SharedResourcePointer<SharedAudioFormatManager> formatManager;
+    
+    ProgramSynthesiser sampler;
     const int numVoices { 3 };
     AudioBuffer<float> waveform;
+    int waveformVersion { 0 };
+    float samplePeak { 0.0f };
     
     ADSR::Parameters ADSRParams;
     
-    AudioFormatManager formatManager;
-    AudioFormatReader* formatReader { nullptr };
+    // sounds are freed here rather than by the voice that happened to play them last
+    ReleasePool releasePool;
+    
+    NoteRenderCache noteRenderCache;
+    bool noteCacheEnabled { true };
+    
+    // declared before the recorder, so they outlive its thread
+    CriticalSection recordedSoundLock;
+    HiSamplerSound::Ptr recordedSound;
+    AudioBuffer<float> recordedWaveform;
+    SampleRecorder sampleRecorder;
+    static constexpr int sidechainBus = 1; // an aux input; a synth has no use for the main one
+    
+    ConvolutionReverb reverb;
+    
+    // program 0
+    ProgramBank::Ptr sampleProgram;
+    // message thread: the program the editor currently shows
+    ProgramBank* displayedProgram { nullptr };
+    
+    // Each program plays its own envelope. The knobs aren't moved to match it when the
+    // program changes, since the host would record that as automation; instead, turning
+    // a knob takes over that stage of the selected program's envelope.
+    enum EnvelopeKnob { attackKnob = 1, decayKnob = 2, sustainKnob = 4, releaseKnob = 8, allEnvelopeKnobs = 15 };
+    std::atomic<ProgramBank*> envelopeProgram { nullptr };  // the program the knobs were last turned on
+    std::atomic<int> movedEnvelopeKnobs { 0 };              // EnvelopeKnob flags
+    
+    ADSR::Parameters withMovedKnobs (ADSR::Parameters envelope) const;
+    void parameterChanged (const String& parameterID, float newValue) override;
+    
+    // message thread: a restored session's program, selected once its bank has loaded
+    int pendingProgramSelection { -1 };
+    
+    // declared before the loader, so they outlive its thread
+    CriticalSection loadedProgramsLock;
+    ReferenceCountedArray<ProgramBank> loadedPrograms;
+    
+    int appliedRenderQuantum { -1 };
+    MidiBuffer chunkMidi;
+    
+    void renderChunk (AudioBuffer<float>& chunk, MidiBuffer& midiMessages);
+    
+    void addSampleSound(HiSamplerSound::Ptr sound, AudioBuffer<float>&& sampleWaveform);
+    void addLoadedPrograms();
+    void refreshRenderCache();
+    void recordingFinished(SampleRecorder::Take&& take);
+    void handleAsyncUpdate() override;
+    
+    ADSR::Parameters getEnvelopeFromParameters() const;
+    void syncToSelectedProgram();
+    void timerCallback() override;
+    
+    ProgramBankLoader programLoader { *formatManager };
     
     AudioProcessorValueTreeState apvts;
     AudioProcessorValueTreeState::ParameterLayout createParameters();
     
+    // looked up once, so updateADSR doesn't do string-keyed lookups on the audio thread
+    std::atomic<float>* attackParam { nullptr };
+    std::atomic<float>* decayParam { nullptr };
+    std::atomic<float>* sustainParam { nullptr };
+    std::atomic<float>* releaseParam { nullptr };
+    std::atomic<float>* startParam { nullptr };
+    std::atomic<float>* endParam { nullptr };
+    std::atomic<float>* reverseParam { nullptr };
+    std::atomic<float>* gainParam { nullptr };
+    std::atomic<float>* normalizeParam { nullptr };
+    std::atomic<float>* reverbParam { nullptr };
+    std::atomic<float>* renderQuantumParam { nullptr };
+    
     std::atomic<bool> shouldUpdate { false };
     
     void valueTreePropertyChanged (ValueTree& treeWhosePropertyHasChanged, const Identifier& property) override;
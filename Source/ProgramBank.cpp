@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    ProgramBank.cpp
+
+  ==============================================================================
+*/
+
+#include "ProgramBank.h"
+
+//==============================================================================
+ProgramBank::ProgramBank (const String& bankName, const ADSR::Parameters& envelopeToUse)
+    : name (bankName), envelope (envelopeToUse)
+{
+}
+
+void ProgramBank::addSound (HiSamplerSound::Ptr sound) {
+    sound->setEnvelopeParameters (envelope);
+    sounds.add (sound);
+}
+
+void ProgramBank::setWaveform (AudioBuffer<float>&& newWaveform, float newPeak) {
+    waveform = std::move (newWaveform);
+    peak = newPeak;
+}
+
+//==============================================================================
+ProgramBankLoader::ProgramBankLoader (AudioFormatManager& formatManagerToUse)
+    : Thread ("hiSampler program loader"), formatManager (formatManagerToUse)
+{
+}
+
+ProgramBankLoader::~ProgramBankLoader() {
+    stopThread (4000);
+}
+
+void ProgramBankLoader::load (const ProgramBank::Description& description) {
+    {
+        const ScopedLock sl (queueLock);
+        queue.add (description);
+    }
+
+    // nothing runs in the background until the first bank is loaded
+    if (! isThreadRunning()) {
+        startThread (4);
+    }
+
+    notify();
+}
+
+void ProgramBankLoader::cancelPending() {
+    const ScopedLock sl (queueLock);
+    queue.clear();
+    ++generation;
+}
+
+void ProgramBankLoader::run() {
+    while (! threadShouldExit()) {
+        ProgramBank::Description description;
+        bool hasWork = false;
+        int descriptionGeneration = 0;
+
+        {
+            const ScopedLock sl (queueLock);
+
+            if (! queue.isEmpty()) {
+                description = queue.removeAndReturn (0);
+                descriptionGeneration = generation;
+                hasWork = true;
+            }
+        }
+
+        if (! hasWork) {
+            wait (-1);
+            continue;
+        }
+
+        if (auto bank = createBank (description)) {
+            // handed over under the lock, so once cancelPending returns nothing older arrives
+            const ScopedLock sl (queueLock);
+
+            if (descriptionGeneration == generation && onProgramLoaded != nullptr) {
+                onProgramLoaded (bank);
+            }
+        }
+    }
+}
+
+ProgramBank::Ptr ProgramBankLoader::createBank (const ProgramBank::Description& description) {
+    ProgramBank::Ptr bank = new ProgramBank (description.name, description.envelope);
+
+    for (auto& zone : description.zones) {
+        // kept even if it doesn't load, so saving the session again doesn't lose it
+        bank->addZone (zone);
+
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor (zone.file));
+
+        if (reader == nullptr || reader->lengthInSamples <= 0) {
+            continue;
+        }
+
+        HiSamplerSound::Ptr sound = new HiSamplerSound (zone.file.getFileNameWithoutExtension(),
+                                                        *reader,
+                                                        zone.midiNotes,
+                                                        zone.midiRootNote,
+                                                        description.envelope.attack,
+                                                        description.envelope.release,
+                                                        maxSampleLengthSeconds);
+
+        // the editor shows the first zone, like loadFile does for a single sample
+        if (bank->getSounds().isEmpty()) {
+            AudioBuffer<float> waveform (1, sound->getLength());
+            reader->read (&waveform, 0, sound->getLength(), 0, true, false);
+            bank->setWaveform (std::move (waveform), sound->getPeak());
+        }
+
+        bank->addSound (sound);
+
+        if (threadShouldExit()) {
+            return {};
+        }
+    }
+
+    return bank;
+}
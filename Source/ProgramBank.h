@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+    ProgramBank.h
+    A program: a set of sounds plus the envelope preset they start with.
+    Banks are decoded on a background thread and every sound is added to
+    the synth up front, so switching programs never loads anything - it
+    only changes which bank's sounds answer new notes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "HiSamplerVoice.h"
+
+//==============================================================================
+class ProgramBank : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<ProgramBank>;
+
+    // One sample and the keys it covers
+    struct Zone
+    {
+        File file;
+        BigInteger midiNotes;
+        int midiRootNote = 60;
+    };
+
+    struct Description
+    {
+        String name;
+        Array<Zone> zones;
+        ADSR::Parameters envelope;
+    };
+
+    ProgramBank (const String& name, const ADSR::Parameters& envelope);
+
+    const String& getName() const noexcept { return name; }
+    void setName (const String& newName) { name = newName; }
+
+    // Message thread: the envelope the bank's sounds start with
+    const ADSR::Parameters& getEnvelope() const noexcept { return envelope; }
+    void setEnvelope (const ADSR::Parameters& newEnvelope) { envelope = newEnvelope; }
+
+    // Build the bank before it's published to the synth; afterwards, message thread only
+    void addSound (HiSamplerSound::Ptr sound);
+    void clearSounds() { sounds.clear(); }
+    const ReferenceCountedArray<HiSamplerSound>& getSounds() const noexcept { return sounds; }
+
+    // The zones the bank was decoded from, so it can be saved and loaded again
+    void addZone (const Zone& zone) { zones.add (zone); }
+    Description getDescription() const { return { name, zones, envelope }; }
+
+    // What the editor shows for this program
+    void setWaveform (AudioBuffer<float>&& newWaveform, float newPeak);
+    const AudioBuffer<float>& getWaveform() const noexcept { return waveform; }
+    float getPeak() const noexcept { return peak; }
+
+private:
+    String name;
+    ADSR::Parameters envelope;
+    ReferenceCountedArray<HiSamplerSound> sounds;
+    Array<Zone> zones;
+
+    AudioBuffer<float> waveform;
+    float peak = 0.0f;
+
+    JUCE_LEAK_DETECTOR (ProgramBank)
+};
+
+//==============================================================================
+// Decodes queued bank descriptions in the background, one at a time.
+class ProgramBankLoader : private Thread
+{
+public:
+    explicit ProgramBankLoader (AudioFormatManager& formatManager);
+    ~ProgramBankLoader() override;
+
+    // Message thread: the bank is handed to onProgramLoaded once every zone is decoded
+    void load (const ProgramBank::Description& description);
+    // Message thread: drops the queued banks, and the one being decoded
+    void cancelPending();
+
+    // Called on the loader thread, once per bank and in the order they were queued. A bank
+    // whose files are missing still comes back, empty, so program numbers stay where they were.
+    std::function<void (ProgramBank::Ptr)> onProgramLoaded;
+
+private:
+    void run() override;
+    ProgramBank::Ptr createBank (const ProgramBank::Description& description);
+
+    static constexpr double maxSampleLengthSeconds = 10.0;
+
+    AudioFormatManager& formatManager;
+
+    CriticalSection queueLock;
+    Array<ProgramBank::Description> queue;
+    int generation = 0;   // bumped by cancelPending, so a bank already being decoded is dropped
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProgramBankLoader)
+};
@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    ProgramSynthesiser.cpp
+
+  ==============================================================================
+*/
+
+#include "ProgramSynthesiser.h"
+
+//==============================================================================
+ProgramSynthesiser::ProgramSynthesiser() {
+    // renderNextBlock takes this every block, which is only a problem when the message thread
+    // is holding it to change the sounds; on POSIX a CriticalSection is just its pthread_mutex_t
+    RealtimeSafetyChecker::checkMutexForContention (&lock);
+}
+
+int ProgramSynthesiser::addProgram (ProgramBank::Ptr bank) {
+    auto index = numPrograms.load();
+
+    if (index >= maxPrograms) {
+        return -1;
+    }
+
+    banks.add (bank);
+
+    for (auto* sound : bank->getSounds()) {
+        sound->setProgram (bank.get(), &selectedProgram);
+        addSound (sound);
+    }
+
+    programs[(size_t) index].store (bank.get(), std::memory_order_release);
+    numPrograms = index + 1;
+
+    // the first program is the one that plays until something else is picked
+    if (index == 0) {
+        selectProgram (0);
+    }
+
+    return index;
+}
+
+void ProgramSynthesiser::addProgramSound (ProgramBank& bank, HiSamplerSound::Ptr sound) {
+    bank.addSound (sound);
+    sound->setProgram (&bank, &selectedProgram);
+    addSound (sound.get());
+}
+
+void ProgramSynthesiser::clearProgramSounds (ProgramBank& bank) {
+    {
+        const ScopedLock sl (lock);
+
+        for (int i = sounds.size(); --i >= 0;) {
+            if (auto* sound = dynamic_cast<HiSamplerSound*> (sounds.getUnchecked (i))) {
+                if (sound->getProgram() == &bank) {
+                    sounds.remove (i);
+                }
+            }
+        }
+    }
+
+    bank.clearSounds();
+}
+
+void ProgramSynthesiser::clearPrograms (ReleasePool& releasePool) {
+    if (numPrograms <= 1) {
+        return;
+    }
+
+    auto* firstProgram = programs[0].load();
+
+    {
+        // MIDI program changes are handled under this lock too, so none can pick a retired bank
+        const ScopedLock sl (lock);
+
+        numPrograms = 1;
+        selectProgram (0);
+
+        for (int i = sounds.size(); --i >= 0;) {
+            if (auto* sound = dynamic_cast<HiSamplerSound*> (sounds.getUnchecked (i))) {
+                if (sound->getProgram() != firstProgram) {
+                    sounds.remove (i);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 1; i < programs.size(); ++i) {
+        programs[i].store (nullptr, std::memory_order_release);
+    }
+
+    for (int i = banks.size(); --i >= 1;) {
+        releasePool.add (banks.getObjectPointerUnchecked (i));
+        banks.remove (i);
+    }
+}
+
+ProgramBank* ProgramSynthesiser::getProgram (int index) const noexcept {
+    if (! isPositiveAndBelow (index, numPrograms.load())) {
+        return nullptr;
+    }
+
+    return programs[(size_t) index].load (std::memory_order_acquire);
+}
+
+void ProgramSynthesiser::selectProgram (int index) noexcept {
+    if (auto* bank = getProgram (index)) {
+        selectedProgram.store (bank, std::memory_order_release);
+    }
+}
+
+int ProgramSynthesiser::getSelectedProgramIndex() const noexcept {
+    auto* selected = getSelectedProgram();
+
+    for (int i = 0; i < numPrograms; ++i) {
+        if (programs[(size_t) i].load (std::memory_order_relaxed) == selected) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+//==============================================================================
+void ProgramSynthesiser::noteOn (int midiChannel, int midiNoteNumber, float velocity) {
+    const ScopedLock sl (lock);
+
+    for (auto* sound : sounds) {
+        // sounds from other programs still answer appliesToNote, so noteOff can find their voices
+        if (auto* programSound = dynamic_cast<HiSamplerSound*> (sound)) {
+            if (! programSound->appliesToNewNote (midiNoteNumber)) {
+                continue;
+            }
+        }
+
+        if (sound->appliesToNote (midiNoteNumber) && sound->appliesToChannel (midiChannel)) {
+            // a note that's still ringing, e.g. held by the sustain pedal, is stopped first
+            for (auto* voice : voices) {
+                if (voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel (midiChannel)) {
+                    voice->stopNote (1.0f, true);
+                }
+            }
+
+            startVoice (findFreeVoice (sound, midiChannel, midiNoteNumber, isNoteStealingEnabled()),
+                        sound, midiChannel, midiNoteNumber, velocity);
+        }
+    }
+}
+
+void ProgramSynthesiser::handleProgramChange (int /*midiChannel*/, int programNumber) {
+    // called from renderNextBlock at the event's position, so the very next note uses it
+    selectProgram (programNumber);
+}
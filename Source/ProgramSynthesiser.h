@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    ProgramSynthesiser.h
+    A Synthesiser that holds every loaded program's sounds at once and picks
+    between them with a single atomic pointer. Program changes - from the
+    host or from MIDI, at their position in the block - only flip that
+    pointer, so they take effect on the next note and never load, lock or
+    allocate. Voices keep their sound, so notes already sounding finish on
+    the program they started with.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ProgramBank.h"
+#include "RealtimeSafetyChecker.h"
+#include "ReleasePool.h"
+
+//==============================================================================
+class ProgramSynthesiser : public Synthesiser
+{
+public:
+    ProgramSynthesiser();
+
+    // One per MIDI program number
+    static constexpr int maxPrograms = 128;
+
+    // Message thread: adds the bank and all its sounds. Returns its program number,
+    // or -1 if every program slot is taken.
+    int addProgram (ProgramBank::Ptr bank);
+
+    // Message thread: replaces a program's sounds
+    void addProgramSound (ProgramBank& bank, HiSamplerSound::Ptr sound);
+    void clearProgramSounds (ProgramBank& bank);
+
+    // Message thread: retires every program but the first, selecting it if one of them was
+    // playing. Their sounds leave the synth under its lock, and the banks go to releasePool.
+    void clearPrograms (ReleasePool& releasePool);
+
+    int getNumPrograms() const noexcept { return numPrograms; }
+    ProgramBank* getProgram (int index) const noexcept;
+
+    // Any thread
+    void selectProgram (int index) noexcept;
+    ProgramBank* getSelectedProgram() const noexcept { return selectedProgram.load (std::memory_order_acquire); }
+    int getSelectedProgramIndex() const noexcept;
+
+    // Audio thread: Synthesiser::noteOn, except that only the selected program's sounds start notes
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity) override;
+
+protected:
+    void handleProgramChange (int midiChannel, int programNumber) override;
+
+private:
+    // message thread only; keeps every bank alive for as long as the synth
+    ReferenceCountedArray<ProgramBank> banks;
+
+    std::array<std::atomic<ProgramBank*>, maxPrograms> programs {};
+    std::atomic<int> numPrograms { 0 };
+    std::atomic<ProgramBank*> selectedProgram { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProgramSynthesiser)
+};
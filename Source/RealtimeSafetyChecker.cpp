@@ -0,0 +1,521 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyChecker.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeSafetyChecker.h"
+
+#if HISAMPLER_RT_SAFETY_CHECKS
+
+#include <new>
+#include <cstdlib>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <pthread.h>
+ #include <unistd.h>
+ #include <cstdarg>
+ #include <cstdio>
+#endif
+
+#if JUCE_MAC
+ #include <cstring>
+ #include <mach/mach.h>
+ #include <mach-o/dyld.h>
+ #include <mach-o/loader.h>
+ #include <mach-o/nlist.h>
+ #include <malloc/malloc.h>
+#endif
+
+#if JUCE_LINUX
+// glibc's own allocator, underneath the malloc family replaced below
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void __libc_free (void*);
+}
+#endif
+
+namespace
+{
+    thread_local int audioCallbackDepth = 0;
+    thread_local bool isReporting = false;   // the report itself allocates and locks
+   #if JUCE_MAC
+    thread_local bool isInOperatorNew = false;   // operator new/delete report for themselves
+   #endif
+    std::atomic<int> numViolations { 0 };
+
+    constexpr int maxContentionMutexes = 8;
+    std::array<std::atomic<const void*>, maxContentionMutexes> contentionMutexes {};
+
+    bool isContentionMutex (const void* mutex) noexcept {
+        for (auto& registered : contentionMutexes) {
+            if (registered.load (std::memory_order_relaxed) == mutex) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+   #if JUCE_LINUX || JUCE_MAC
+    // Shared by the platform hooks: a registered mutex that's free is taken without a report
+    int lockMutex (pthread_mutex_t* mutex, int (*realLock) (pthread_mutex_t*)) {
+        if (RealtimeSafetyChecker::isInAudioCallback()) {
+            if (! isContentionMutex (mutex)) {
+                RealtimeSafetyChecker::check ("pthread_mutex_lock");
+            }
+            else if (pthread_mutex_trylock (mutex) == 0) {
+                return 0;
+            }
+            else {
+                RealtimeSafetyChecker::check ("pthread_mutex_lock, held by another thread");
+            }
+        }
+
+        return realLock (mutex);
+    }
+   #endif
+
+   #if JUCE_MAC
+    // the default zone's functions from before we replaced them
+    malloc_zone_t originalZone {};
+   #endif
+
+    // operator new/delete report for themselves, so they skip the malloc hooks
+   #if JUCE_LINUX
+    void* allocate (std::size_t size) noexcept { return __libc_malloc (size); }
+    void deallocate (void* ptr) noexcept       { __libc_free (ptr); }
+   #elif JUCE_MAC
+    void* allocate (std::size_t size) noexcept {
+        isInOperatorNew = true;
+        auto* ptr = std::malloc (size);
+        isInOperatorNew = false;
+        return ptr;
+    }
+
+    void deallocate (void* ptr) noexcept {
+        isInOperatorNew = true;
+        std::free (ptr);
+        isInOperatorNew = false;
+    }
+   #else
+    void* allocate (std::size_t size) noexcept { return std::malloc (size); }
+    void deallocate (void* ptr) noexcept       { std::free (ptr); }
+   #endif
+}
+
+//==============================================================================
+RealtimeSafetyChecker::ScopedAudioCallback::ScopedAudioCallback() noexcept  { ++audioCallbackDepth; }
+RealtimeSafetyChecker::ScopedAudioCallback::~ScopedAudioCallback() noexcept { --audioCallbackDepth; }
+
+bool RealtimeSafetyChecker::isInAudioCallback() noexcept {
+    return audioCallbackDepth > 0;
+}
+
+int RealtimeSafetyChecker::getNumViolations() noexcept {
+    return numViolations.load();
+}
+
+void RealtimeSafetyChecker::resetNumViolations() noexcept {
+    numViolations = 0;
+}
+
+void RealtimeSafetyChecker::checkMutexForContention (const void* mutex) noexcept {
+    for (auto& registered : contentionMutexes) {
+        const void* expected = nullptr;
+
+        if (registered.load() == mutex || registered.compare_exchange_strong (expected, mutex)) {
+            return;
+        }
+    }
+
+    jassertfalse; // raise maxContentionMutexes
+}
+
+void RealtimeSafetyChecker::check (const char* operation) noexcept {
+    if (audioCallbackDepth <= 0 || isReporting) {
+        return;
+    }
+
+    isReporting = true;
+    ++numViolations;
+
+    Logger::writeToLog ("Real-time safety violation on the audio thread: " + String (operation) + newLine
+                          + SystemStats::getStackBacktrace());
+    jassertfalse;
+
+    isReporting = false;
+}
+
+//==============================================================================
+void* operator new (std::size_t size) {
+    RealtimeSafetyChecker::check ("operator new");
+
+    if (auto* ptr = allocate (size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size) {
+    RealtimeSafetyChecker::check ("operator new[]");
+
+    if (auto* ptr = allocate (size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete (void* ptr) noexcept {
+    if (ptr != nullptr) {
+        RealtimeSafetyChecker::check ("operator delete");
+    }
+
+    deallocate (ptr);
+}
+
+void operator delete[] (void* ptr) noexcept {
+    if (ptr != nullptr) {
+        RealtimeSafetyChecker::check ("operator delete[]");
+    }
+
+    deallocate (ptr);
+}
+
+void operator delete (void* ptr, std::size_t) noexcept   { operator delete (ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept { operator delete[] (ptr); }
+
+//==============================================================================
+#if JUCE_LINUX
+// Forwards to the next definition of the symbol (normally libc's). The cached
+// pointer is constant-initialised, so no static-init guard (or its mutex) is involved.
+#define HISAMPLER_RT_NEXT(name) \
+    static decltype (&::name) real_##name = nullptr; \
+    if (real_##name == nullptr) real_##name = (decltype (&::name)) dlsym (RTLD_NEXT, #name);
+
+extern "C"
+{
+    void* malloc (size_t size) {
+        RealtimeSafetyChecker::check ("malloc");
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size) {
+        RealtimeSafetyChecker::check ("calloc");
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* ptr, size_t size) {
+        RealtimeSafetyChecker::check ("realloc");
+        return __libc_realloc (ptr, size);
+    }
+
+    void free (void* ptr) {
+        if (ptr != nullptr) {
+            RealtimeSafetyChecker::check ("free");
+        }
+
+        __libc_free (ptr);
+    }
+
+    int pthread_mutex_lock (pthread_mutex_t* mutex) {
+        HISAMPLER_RT_NEXT (pthread_mutex_lock)
+        return lockMutex (mutex, real_pthread_mutex_lock);
+    }
+
+    int open (const char* path, int flags, ...) {
+        RealtimeSafetyChecker::check ("open");
+        HISAMPLER_RT_NEXT (open)
+
+        mode_t mode = 0;
+
+        if ((flags & O_CREAT) != 0) {
+            va_list args;
+            va_start (args, flags);
+            mode = (mode_t) va_arg (args, int);
+            va_end (args);
+        }
+
+        return real_open (path, flags, mode);
+    }
+
+    FILE* fopen (const char* path, const char* mode) {
+        RealtimeSafetyChecker::check ("fopen");
+        HISAMPLER_RT_NEXT (fopen)
+        return real_fopen (path, mode);
+    }
+
+    ssize_t read (int fd, void* buffer, size_t count) {
+        RealtimeSafetyChecker::check ("read");
+        HISAMPLER_RT_NEXT (read)
+        return real_read (fd, buffer, count);
+    }
+
+    ssize_t write (int fd, const void* buffer, size_t count) {
+        RealtimeSafetyChecker::check ("write");
+        HISAMPLER_RT_NEXT (write)
+        return real_write (fd, buffer, count);
+    }
+}
+
+#undef HISAMPLER_RT_NEXT
+#endif
+
+//==============================================================================
+#if JUCE_MAC
+// A plugin's own calls to libSystem never go through dyld interposing, so the malloc
+// family is caught by replacing the default zone's functions, and the rest by rewriting
+// this binary's imported symbol pointers.
+namespace
+{
+    void checkZoneCall (const char* operation) noexcept {
+        if (! isInOperatorNew) {
+            RealtimeSafetyChecker::check (operation);
+        }
+    }
+
+    void* zoneMalloc (malloc_zone_t* zone, size_t size) {
+        checkZoneCall ("malloc");
+        return originalZone.malloc (zone, size);
+    }
+
+    void* zoneCalloc (malloc_zone_t* zone, size_t count, size_t size) {
+        checkZoneCall ("calloc");
+        return originalZone.calloc (zone, count, size);
+    }
+
+    void* zoneRealloc (malloc_zone_t* zone, void* ptr, size_t size) {
+        checkZoneCall ("realloc");
+        return originalZone.realloc (zone, ptr, size);
+    }
+
+    void zoneFree (malloc_zone_t* zone, void* ptr) {
+        if (ptr != nullptr) {
+            checkZoneCall ("free");
+        }
+
+        originalZone.free (zone, ptr);
+    }
+
+    void zoneFreeDefiniteSize (malloc_zone_t* zone, void* ptr, size_t size) {
+        if (ptr != nullptr) {
+            checkZoneCall ("free");
+        }
+
+        originalZone.free_definite_size (zone, ptr, size);
+    }
+
+    void installZoneHooks() {
+        // malloc_default_zone() may be a forwarding zone; the first registered one is the real default
+        vm_address_t* zones = nullptr;
+        unsigned int numZones = 0;
+
+        if (malloc_get_all_zones (mach_task_self(), nullptr, &zones, &numZones) != KERN_SUCCESS || numZones == 0) {
+            return;
+        }
+
+        auto* zone = reinterpret_cast<malloc_zone_t*> (zones[0]);
+        originalZone = *zone;
+
+        // newer systems keep the zone read-only
+        vm_protect (mach_task_self(), (vm_address_t) zone, sizeof (malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+
+        zone->malloc = zoneMalloc;
+        zone->calloc = zoneCalloc;
+        zone->realloc = zoneRealloc;
+        zone->free = zoneFree;
+
+        if (zone->version >= 6 && zone->free_definite_size != nullptr) {
+            zone->free_definite_size = zoneFreeDefiniteSize;
+        }
+
+        vm_protect (mach_task_self(), (vm_address_t) zone, sizeof (malloc_zone_t), 0, VM_PROT_READ);
+    }
+
+    //==============================================================================
+    int (*realMutexLock) (pthread_mutex_t*) = nullptr;
+    int (*realOpen) (const char*, int, ...) = nullptr;
+    FILE* (*realFopen) (const char*, const char*) = nullptr;
+    ssize_t (*realRead) (int, void*, size_t) = nullptr;
+    ssize_t (*realWrite) (int, const void*, size_t) = nullptr;
+
+    int checkedMutexLock (pthread_mutex_t* mutex) {
+        return lockMutex (mutex, realMutexLock);
+    }
+
+    int checkedOpen (const char* path, int flags, ...) {
+        RealtimeSafetyChecker::check ("open");
+        int mode = 0;
+
+        if ((flags & O_CREAT) != 0) {
+            va_list args;
+            va_start (args, flags);
+            mode = va_arg (args, int);
+            va_end (args);
+        }
+
+        return realOpen (path, flags, mode);
+    }
+
+    FILE* checkedFopen (const char* path, const char* mode) {
+        RealtimeSafetyChecker::check ("fopen");
+        return realFopen (path, mode);
+    }
+
+    ssize_t checkedRead (int fd, void* buffer, size_t count) {
+        RealtimeSafetyChecker::check ("read");
+        return realRead (fd, buffer, count);
+    }
+
+    ssize_t checkedWrite (int fd, const void* buffer, size_t count) {
+        RealtimeSafetyChecker::check ("write");
+        return realWrite (fd, buffer, count);
+    }
+
+    struct Rebinding
+    {
+        const char* name;   // without the leading underscore
+        void* replacement;
+    };
+
+    // Points every lazy and non-lazy import of the named symbols in one image at the replacement
+    void rebindImports (const mach_header_64* header, intptr_t slide, const Rebinding* rebindings, int numRebindings) {
+        const segment_command_64* linkedit = nullptr;
+        const symtab_command* symtab = nullptr;
+        const dysymtab_command* dysymtab = nullptr;
+
+        auto* firstCommand = reinterpret_cast<const load_command*> (header + 1);
+        auto* command = firstCommand;
+
+        for (uint32_t i = 0; i < header->ncmds; ++i) {
+            if (command->cmd == LC_SEGMENT_64) {
+                auto* segment = reinterpret_cast<const segment_command_64*> (command);
+
+                if (std::strcmp (segment->segname, SEG_LINKEDIT) == 0) {
+                    linkedit = segment;
+                }
+            }
+            else if (command->cmd == LC_SYMTAB) {
+                symtab = reinterpret_cast<const symtab_command*> (command);
+            }
+            else if (command->cmd == LC_DYSYMTAB) {
+                dysymtab = reinterpret_cast<const dysymtab_command*> (command);
+            }
+
+            command = reinterpret_cast<const load_command*> (reinterpret_cast<const char*> (command) + command->cmdsize);
+        }
+
+        if (linkedit == nullptr || symtab == nullptr || dysymtab == nullptr || dysymtab->nindirectsyms == 0) {
+            return;
+        }
+
+        auto linkeditBase = (uintptr_t) slide + linkedit->vmaddr - linkedit->fileoff;
+        auto* symbols = reinterpret_cast<const nlist_64*> (linkeditBase + symtab->symoff);
+        auto* strings = reinterpret_cast<const char*> (linkeditBase + symtab->stroff);
+        auto* indirectSymbols = reinterpret_cast<const uint32_t*> (linkeditBase + dysymtab->indirectsymoff);
+
+        command = firstCommand;
+
+        for (uint32_t i = 0; i < header->ncmds; ++i) {
+            if (command->cmd == LC_SEGMENT_64) {
+                auto* segment = reinterpret_cast<const segment_command_64*> (command);
+                auto* sections = reinterpret_cast<const section_64*> (segment + 1);
+
+                for (uint32_t j = 0; j < segment->nsects; ++j) {
+                    auto type = sections[j].flags & SECTION_TYPE;
+
+                    if (type != S_LAZY_SYMBOL_POINTERS && type != S_NON_LAZY_SYMBOL_POINTERS) {
+                        continue;
+                    }
+
+                    auto** pointers = reinterpret_cast<void**> ((uintptr_t) slide + sections[j].addr);
+                    auto numPointers = sections[j].size / sizeof (void*);
+                    auto* indices = indirectSymbols + sections[j].reserved1;
+
+                    for (uint64_t k = 0; k < numPointers; ++k) {
+                        auto index = indices[k];
+
+                        if ((index & (INDIRECT_SYMBOL_LOCAL | INDIRECT_SYMBOL_ABS)) != 0) {
+                            continue;
+                        }
+
+                        auto* name = strings + symbols[index].n_un.n_strx;
+
+                        if (name[0] != '_') {
+                            continue;
+                        }
+
+                        for (int r = 0; r < numRebindings; ++r) {
+                            if (std::strcmp (name + 1, rebindings[r].name) == 0) {
+                                // __DATA_CONST is read-only once dyld has bound it
+                                vm_protect (mach_task_self(), (vm_address_t) &pointers[k], sizeof (void*), 0,
+                                            VM_PROT_READ | VM_PROT_WRITE | VM_PROT_COPY);
+                                pointers[k] = rebindings[r].replacement;
+                            }
+                        }
+                    }
+                }
+            }
+
+            command = reinterpret_cast<const load_command*> (reinterpret_cast<const char*> (command) + command->cmdsize);
+        }
+    }
+
+    void installImportHooks() {
+        realMutexLock = reinterpret_cast<decltype (realMutexLock)> (dlsym (RTLD_DEFAULT, "pthread_mutex_lock"));
+        realOpen = reinterpret_cast<decltype (realOpen)> (dlsym (RTLD_DEFAULT, "open"));
+        realFopen = reinterpret_cast<decltype (realFopen)> (dlsym (RTLD_DEFAULT, "fopen"));
+        realRead = reinterpret_cast<decltype (realRead)> (dlsym (RTLD_DEFAULT, "read"));
+        realWrite = reinterpret_cast<decltype (realWrite)> (dlsym (RTLD_DEFAULT, "write"));
+
+        if (realMutexLock == nullptr || realOpen == nullptr || realFopen == nullptr || realRead == nullptr || realWrite == nullptr) {
+            return;
+        }
+
+        const Rebinding rebindings[] = {
+            { "pthread_mutex_lock", reinterpret_cast<void*> (checkedMutexLock) },
+            { "open",               reinterpret_cast<void*> (checkedOpen) },
+            { "fopen",              reinterpret_cast<void*> (checkedFopen) },
+            { "read",               reinterpret_cast<void*> (checkedRead) },
+            { "write",              reinterpret_cast<void*> (checkedWrite) }
+        };
+
+        // only the binary this file is linked into: the plugin bundle, or the Standalone app
+        Dl_info info;
+
+        if (dladdr (reinterpret_cast<const void*> (installImportHooks), &info) == 0) {
+            return;
+        }
+
+        for (uint32_t i = 0; i < _dyld_image_count(); ++i) {
+            if (_dyld_get_image_header (i) == info.dli_fbase) {
+                rebindImports (reinterpret_cast<const mach_header_64*> (info.dli_fbase), _dyld_get_image_vmaddr_slide (i),
+                               rebindings, (int) (sizeof (rebindings) / sizeof (rebindings[0])));
+                break;
+            }
+        }
+    }
+
+    // installed when the binary loads, before any audio callback can run
+    struct HookInstaller
+    {
+        HookInstaller() {
+            installZoneHooks();
+            installImportHooks();
+        }
+    };
+
+    HookInstaller hookInstaller;
+}
+#endif
+
+#endif
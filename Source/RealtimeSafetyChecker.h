@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyChecker.h
+    Debug/CI mode that reports allocations, mutex locks and file I/O made while
+    the audio callback is running. Build with HISAMPLER_RT_SAFETY_CHECKS=1 (e.g.
+    add it to the Projucer preprocessor definitions of a CI configuration) to
+    turn it on; otherwise everything here compiles away.
+
+    This is a debugging aid, not a guarantee: calls it can't see aren't
+    reported. operator new/delete are replaced everywhere. The rest depends on
+    the platform:
+     - macOS: the default malloc zone's functions are replaced, so malloc,
+       calloc, realloc and free (which JUCE's HeapBlock uses directly) are
+       seen from every image. pthread_mutex_lock and file I/O are rebound in
+       this binary's own imports, which covers JUCE and hiSampler but not
+       calls made inside the host or system frameworks.
+     - Linux: the malloc family, pthread_mutex_lock and file I/O are
+       interposed, but only when this code is in the executable (Standalone
+       or a headless host); inside a plugin the host loads, libc's win.
+
+    The Synthesiser's own lock is taken by renderNextBlock every block, and by
+    the message thread while it adds or removes sounds. checkMutexForContention()
+    makes locking such a mutex a violation only when another thread holds it,
+    which is the priority inversion that matters.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef HISAMPLER_RT_SAFETY_CHECKS
+ #define HISAMPLER_RT_SAFETY_CHECKS 0
+#endif
+
+//==============================================================================
+struct RealtimeSafetyChecker
+{
+    // Marks the current thread as being inside the audio callback for its lifetime.
+    struct ScopedAudioCallback
+    {
+       #if HISAMPLER_RT_SAFETY_CHECKS
+        ScopedAudioCallback() noexcept;
+        ~ScopedAudioCallback() noexcept;
+       #else
+        ScopedAudioCallback() noexcept {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedAudioCallback)
+    };
+
+   #if HISAMPLER_RT_SAFETY_CHECKS
+    // Called by the hooks. If the calling thread is inside the audio callback, logs
+    // the violation with a stack trace and hits a jassert.
+    static void check (const char* operation) noexcept;
+
+    static bool isInAudioCallback() noexcept;
+    static int getNumViolations() noexcept;
+    static void resetNumViolations() noexcept;
+
+    // Locking this mutex (a CriticalSection, or a pthread_mutex_t) on the audio thread is
+    // only reported if it's contended, i.e. another thread holds it at the time
+    static void checkMutexForContention (const void* mutex) noexcept;
+   #else
+    static void check (const char*) noexcept {}
+    static bool isInAudioCallback() noexcept { return false; }
+    static int getNumViolations() noexcept { return 0; }
+    static void resetNumViolations() noexcept {}
+    static void checkMutexForContention (const void*) noexcept {}
+   #endif
+};
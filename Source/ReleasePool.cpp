@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    ReleasePool.cpp
+
+  ==============================================================================
+*/
+
+#include "ReleasePool.h"
+
+//==============================================================================
+ReleasePool::ReleasePool() : Thread ("hiSampler release pool") {}
+
+ReleasePool::~ReleasePool() {
+    stopThread (2000);
+}
+
+void ReleasePool::add (ReferenceCountedObject* object) {
+    if (object == nullptr) {
+        return;
+    }
+
+    {
+        const ScopedLock sl (lock);
+        objects.addIfNotAlreadyThere (object);
+    }
+
+    // nothing runs in the background until the first object arrives
+    if (! isThreadRunning()) {
+        startThread (2);
+    }
+}
+
+int ReleasePool::getNumObjects() const {
+    const ScopedLock sl (lock);
+    return objects.size();
+}
+
+void ReleasePool::run() {
+    while (! threadShouldExit()) {
+        ReferenceCountedArray<ReferenceCountedObject> unused;
+
+        {
+            const ScopedLock sl (lock);
+
+            // only we can see these, so a count of one can't go back up
+            for (int i = objects.size(); --i >= 0;) {
+                if (objects.getUnchecked (i)->getReferenceCount() == 1) {
+                    unused.add (objects.removeAndReturn (i));
+                }
+            }
+        }
+
+        // freed here, outside the lock, so add() never waits on a large free
+        unused.clear();
+
+        wait (pollIntervalMs);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+
+    ReleasePool.h
+    Keeps an extra reference to every object the audio thread might be
+    holding on to, such as sounds a voice is still playing. Whichever thread
+    drops the last of the other references, the pool's still there, and its
+    background thread frees the object once nothing else refers to it - so
+    sample buffers are never freed inside the audio callback.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class ReleasePool : private Thread
+{
+public:
+    ReleasePool();
+    ~ReleasePool() override;
+
+    // Any thread but the audio thread: call this before the object is handed to it
+    void add (ReferenceCountedObject* object);
+
+    int getNumObjects() const;
+
+private:
+    void run() override;
+
+    static constexpr int pollIntervalMs = 100;
+
+    CriticalSection lock;
+    ReferenceCountedArray<ReferenceCountedObject> objects;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ReleasePool)
+};
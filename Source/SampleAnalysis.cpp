@@ -0,0 +1,143 @@
+/*
+  ==============================================================================
+
+    SampleAnalysis.cpp
+
+  ==============================================================================
+*/
+
+#include "SampleAnalysis.h"
+#include <future>
+
+namespace
+{
+    // below this, starting another thread costs more than it saves
+    constexpr int minSegmentLength = 1 << 16;
+    constexpr int maxNumSegments = 8;
+
+    struct Segment
+    {
+        int begin = 0, end = 0;
+        float peak = 0.0f;
+        double sumOfSquares = 0.0;
+        std::vector<int> zeroCrossings;
+    };
+
+    void analyseSegment (const AudioBuffer<float>& data, Segment& segment) {
+        auto numChannels = data.getNumChannels();
+
+        for (int channel = 0; channel < numChannels; ++channel) {
+            auto samples = data.getReadPointer (channel);
+
+            for (int i = segment.begin; i < segment.end; ++i) {
+                segment.peak = jmax (segment.peak, std::abs (samples[i]));
+                segment.sumOfSquares += samples[i] * samples[i];
+            }
+        }
+
+        // crossings of the channels mixed together, so a snapped trim suits all of them;
+        // the first sample is compared with the one before it, even if that's in another segment
+        auto mixedSample = [&data, numChannels] (int index) {
+            float sum = 0.0f;
+
+            for (int channel = 0; channel < numChannels; ++channel) {
+                sum += data.getSample (channel, index);
+            }
+
+            return sum;
+        };
+
+        auto previous = segment.begin > 0 ? mixedSample (segment.begin - 1) : 0.0f;
+
+        for (int i = segment.begin; i < segment.end; ++i) {
+            auto current = mixedSample (i);
+
+            if (i > 0 && (previous < 0.0f) != (current < 0.0f)) {
+                segment.zeroCrossings.push_back (i);
+            }
+
+            previous = current;
+        }
+    }
+}
+
+//==============================================================================
+SampleAnalysis SampleAnalysis::analyse (const AudioBuffer<float>& data, int length) {
+    SampleAnalysis analysis;
+    length = jmin (length, data.getNumSamples());
+
+    if (length <= 0 || data.getNumChannels() == 0) {
+        return analysis;
+    }
+
+    auto numSegments = jlimit (1, jmin (maxNumSegments, SystemStats::getNumCpus()), length / minSegmentLength);
+    std::vector<Segment> segments ((size_t) numSegments);
+
+    for (int i = 0; i < numSegments; ++i) {
+        segments[(size_t) i].begin = (int) ((int64) length * i / numSegments);
+        segments[(size_t) i].end = (int) ((int64) length * (i + 1) / numSegments);
+    }
+
+    // the calling thread takes the first segment itself
+    std::vector<std::future<void>> jobs;
+
+    for (size_t i = 1; i < segments.size(); ++i) {
+        jobs.push_back (std::async (std::launch::async, [&data, &segments, i] { analyseSegment (data, segments[i]); }));
+    }
+
+    analyseSegment (data, segments[0]);
+
+    double sumOfSquares = 0.0;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (i > 0) {
+            jobs[i - 1].get();
+        }
+
+        auto& segment = segments[i];
+        analysis.peak = jmax (analysis.peak, segment.peak);
+        sumOfSquares += segment.sumOfSquares;
+        analysis.zeroCrossings.insert (analysis.zeroCrossings.end(), segment.zeroCrossings.begin(), segment.zeroCrossings.end());
+    }
+
+    analysis.rms = (float) std::sqrt (sumOfSquares / ((double) length * data.getNumChannels()));
+
+    // leading silence only delays the note, so playback starts where the sound does
+    auto threshold = analysis.peak * Decibels::decibelsToGain (onsetThresholdDecibels);
+
+    if (analysis.peak > 0.0f) {
+        for (int i = 0; i < length; ++i) {
+            bool isAbove = false;
+
+            for (int channel = 0; channel < data.getNumChannels(); ++channel) {
+                isAbove = isAbove || std::abs (data.getSample (channel, i)) > threshold;
+            }
+
+            if (isAbove) {
+                // everything before here is below the threshold, so starting there can't click
+                analysis.onset = jmax (0, i - 1);
+                break;
+            }
+        }
+    }
+
+    return analysis;
+}
+
+int SampleAnalysis::getNearestZeroCrossing (int position, int maxDistance) const noexcept {
+    auto next = std::lower_bound (zeroCrossings.begin(), zeroCrossings.end(), position);
+    auto nearest = position;
+    auto distance = maxDistance + 1;
+
+    if (next != zeroCrossings.end()) {
+        nearest = *next;
+        distance = *next - position;
+    }
+
+    if (next != zeroCrossings.begin() && position - *(next - 1) < distance) {
+        nearest = *(next - 1);
+        distance = position - nearest;
+    }
+
+    return distance <= maxDistance ? nearest : position;
+}
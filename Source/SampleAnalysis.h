@@ -0,0 +1,33 @@
+/*
+  ==============================================================================
+
+    SampleAnalysis.h
+    Measurements taken once, when a sample is loaded, and kept with it: where
+    the sound actually starts, its peak and RMS level, and every zero
+    crossing, so trims can be snapped to points that don't click. Long
+    samples are split into segments that are analysed in parallel.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+struct SampleAnalysis
+{
+    int onset = 0;                      // last sample before the sound first rises above the onset threshold
+    float peak = 0.0f;
+    float rms = 0.0f;
+    std::vector<int> zeroCrossings;     // ascending; sample i crosses if it's on the other side of zero to sample i - 1
+
+    // Reads the first length samples of every channel. Call this on a loader thread.
+    static SampleAnalysis analyse (const AudioBuffer<float>& data, int length);
+
+    // A binary search, so it's fine on the audio thread. Returns position itself
+    // if there's no zero crossing within maxDistance samples.
+    int getNearestZeroCrossing (int position, int maxDistance) const noexcept;
+
+    static constexpr float onsetThresholdDecibels = -60.0f;   // relative to the peak
+};
@@ -0,0 +1,351 @@
+/*
+  ==============================================================================
+
+    SampleMemoryArena.cpp
+
+  ==============================================================================
+*/
+
+#include "SampleMemoryArena.h"
+
+#if JUCE_LINUX || JUCE_ANDROID || JUCE_MAC || JUCE_IOS
+ #define HISAMPLER_ARENA_USES_MMAP 1
+ #include <sys/mman.h>
+ #include <unistd.h>
+ #if JUCE_MAC || JUCE_IOS
+  #include <mach/vm_statistics.h>
+ #endif
+#elif JUCE_WINDOWS
+ #define HISAMPLER_ARENA_USES_MMAP 0
+ #include <windows.h>
+#else
+ #define HISAMPLER_ARENA_USES_MMAP 0
+#endif
+
+namespace
+{
+    constexpr size_t hugePageSize = 2 * 1024 * 1024;
+    constexpr size_t chunkSize = hugePageSize;
+    constexpr size_t maxChunkAllocation = chunkSize / 4; // bigger ones would waste too much of a chunk
+
+    std::atomic<bool> lockingEnabled { false };
+    std::atomic<int64> residentBytes { 0 }, hugePageBytes { 0 }, hugePagesRequestedBytes { 0 }, lockedBytes { 0 };
+    std::atomic<int> lockFailures { 0 };
+
+    // How one region (a chunk, or a large allocation) was mapped
+    struct Mapping
+    {
+        size_t numBytes;
+        bool isHugePage;
+        bool isHugePageRequested;
+        bool isLocked;
+    };
+
+    // Every allocation starts with this, so release() knows where it came from
+    struct Header
+    {
+        Mapping mapping;   // only used when chunk is null
+        char* chunk;       // the chunk this allocation was carved from, if any
+    };
+
+    // The start of every chunk
+    struct ChunkHeader
+    {
+        Mapping mapping;
+        size_t numBytesUsed;
+        int numAllocations;
+    };
+
+    constexpr size_t headerSize = 64; // keeps the samples cache-line aligned
+
+    // Only the chunk being carved up is kept here; full ones are found through their allocations
+    CriticalSection chunkLock;
+    char* currentChunk = nullptr;
+
+    size_t getPageSize() noexcept {
+       #if HISAMPLER_ARENA_USES_MMAP
+        return (size_t) sysconf (_SC_PAGESIZE);
+       #elif JUCE_WINDOWS
+        SYSTEM_INFO info;
+        GetSystemInfo (&info);
+        return (size_t) info.dwPageSize;
+       #else
+        return 4096;
+       #endif
+    }
+
+    size_t roundUp (size_t numBytes, size_t multiple) noexcept {
+        return (numBytes + multiple - 1) / multiple * multiple;
+    }
+
+    // numBytes is a multiple of the page size; it's rounded up further if huge pages are used.
+    // isHugePageRequested means transparent huge pages were asked for, which the kernel may ignore.
+    void* mapPages (size_t& numBytes, bool& isHugePage, bool& isHugePageRequested) {
+        isHugePage = false;
+        isHugePageRequested = false;
+
+       #if HISAMPLER_ARENA_USES_MMAP
+        if (numBytes >= hugePageSize) {
+            auto hugeBytes = roundUp (numBytes, hugePageSize);
+
+           #if defined (MAP_HUGETLB)
+            // explicit huge pages only exist if the system has reserved some
+            auto* hugeMemory = mmap (nullptr, hugeBytes, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+           #elif defined (VM_FLAGS_SUPERPAGE_SIZE_2MB)
+            auto* hugeMemory = mmap (nullptr, hugeBytes, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+           #else
+            void* hugeMemory = MAP_FAILED;
+           #endif
+
+            if (hugeMemory != MAP_FAILED) {
+                isHugePage = true;
+                numBytes = hugeBytes;
+                return hugeMemory;
+            }
+        }
+
+        auto* memory = mmap (nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+
+       #if defined (MADV_HUGEPAGE)
+        // transparent huge pages, where the kernel has them enabled
+        if (numBytes >= hugePageSize && madvise (memory, numBytes, MADV_HUGEPAGE) == 0) {
+            isHugePageRequested = true;
+        }
+       #endif
+
+        return memory;
+       #elif JUCE_WINDOWS
+        if (numBytes >= hugePageSize) {
+            // needs the "Lock pages in memory" privilege, which most users don't have
+            if (auto largePageSize = GetLargePageMinimum()) {
+                auto hugeBytes = roundUp (numBytes, largePageSize);
+
+                if (auto* hugeMemory = VirtualAlloc (nullptr, hugeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)) {
+                    isHugePage = true;
+                    numBytes = hugeBytes;
+                    return hugeMemory;
+                }
+            }
+        }
+
+        return VirtualAlloc (nullptr, numBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+       #else
+        return std::calloc (1, numBytes);
+       #endif
+    }
+
+    void unmapPages (void* memory, size_t numBytes) noexcept {
+       #if HISAMPLER_ARENA_USES_MMAP
+        munmap (memory, numBytes);
+       #elif JUCE_WINDOWS
+        ignoreUnused (numBytes);
+        VirtualFree (memory, 0, MEM_RELEASE);
+       #else
+        ignoreUnused (numBytes);
+        std::free (memory);
+       #endif
+    }
+
+    bool lockPages (void* memory, size_t numBytes) noexcept {
+       #if HISAMPLER_ARENA_USES_MMAP
+        return mlock (memory, numBytes) == 0;
+       #elif JUCE_WINDOWS
+        return VirtualLock (memory, numBytes) != 0;
+       #else
+        ignoreUnused (memory, numBytes);
+        return false;
+       #endif
+    }
+
+    void unlockPages (void* memory, size_t numBytes) noexcept {
+       #if HISAMPLER_ARENA_USES_MMAP
+        munlock (memory, numBytes);
+       #elif JUCE_WINDOWS
+        VirtualUnlock (memory, numBytes);
+       #else
+        ignoreUnused (memory, numBytes);
+       #endif
+    }
+
+    // Maps, prefaults and (if enabled) locks at least numBytes, which is a multiple of the page size
+    char* mapRegion (size_t numBytes, Mapping& mapping) {
+        auto pageSize = getPageSize();
+        mapping = { numBytes, false, false, false };
+
+        auto* base = static_cast<char*> (mapPages (mapping.numBytes, mapping.isHugePage, mapping.isHugePageRequested));
+
+        if (base == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        // fresh pages are already zero, but writing to each one makes the OS back it now
+        for (size_t offset = 0; offset < mapping.numBytes; offset += pageSize) {
+            base[offset] = 0;
+        }
+
+        if (lockingEnabled) {
+            mapping.isLocked = lockPages (base, mapping.numBytes);
+
+            if (mapping.isLocked) {
+                lockedBytes += (int64) mapping.numBytes;
+            }
+            else {
+                ++lockFailures;
+            }
+        }
+
+        residentBytes += (int64) mapping.numBytes;
+
+        if (mapping.isHugePage) {
+            hugePageBytes += (int64) mapping.numBytes;
+        }
+
+        if (mapping.isHugePageRequested) {
+            hugePagesRequestedBytes += (int64) mapping.numBytes;
+        }
+
+        return base;
+    }
+
+    void unmapRegion (char* base, const Mapping& mapping) noexcept {
+        if (mapping.isLocked) {
+            unlockPages (base, mapping.numBytes);
+            lockedBytes -= (int64) mapping.numBytes;
+        }
+
+        residentBytes -= (int64) mapping.numBytes;
+
+        if (mapping.isHugePage) {
+            hugePageBytes -= (int64) mapping.numBytes;
+        }
+
+        if (mapping.isHugePageRequested) {
+            hugePagesRequestedBytes -= (int64) mapping.numBytes;
+        }
+
+        unmapPages (base, mapping.numBytes);
+    }
+
+    ChunkHeader& getChunkHeader (char* chunk) noexcept {
+        return *reinterpret_cast<ChunkHeader*> (chunk);
+    }
+
+    // Called with chunkLock held. Returns the start of slotBytes of zeroed memory inside a chunk.
+    char* carveFromChunk (size_t slotBytes) {
+        if (currentChunk != nullptr) {
+            auto& chunk = getChunkHeader (currentChunk);
+
+            // an empty chunk starts over rather than being unmapped and mapped again
+            if (chunk.numAllocations == 0) {
+                chunk.numBytesUsed = headerSize;
+            }
+
+            if (chunk.numBytesUsed + slotBytes > chunk.mapping.numBytes) {
+                // whatever still lives in it keeps it mapped; the last release unmaps it
+                if (chunk.numAllocations == 0) {
+                    unmapRegion (currentChunk, chunk.mapping);
+                }
+
+                currentChunk = nullptr;
+            }
+        }
+
+        if (currentChunk == nullptr) {
+            Mapping mapping;
+            auto* newChunk = mapRegion (chunkSize, mapping);
+            getChunkHeader (newChunk) = { mapping, headerSize, 0 };
+            currentChunk = newChunk;
+        }
+
+        auto& chunk = getChunkHeader (currentChunk);
+        auto* slot = currentChunk + chunk.numBytesUsed;
+        chunk.numBytesUsed += slotBytes;
+        ++chunk.numAllocations;
+
+        // a chunk that started over may hand out memory that was used before
+        std::memset (slot, 0, slotBytes);
+        return slot;
+    }
+}
+
+//==============================================================================
+void* SampleMemoryArena::allocate (size_t numBytes) {
+    auto slotBytes = roundUp (numBytes + headerSize, headerSize);
+
+    if (slotBytes <= maxChunkAllocation) {
+        const ScopedLock sl (chunkLock);
+        auto* base = carveFromChunk (slotBytes);
+        *reinterpret_cast<Header*> (base) = { {}, currentChunk };
+        return base + headerSize;
+    }
+
+    Mapping mapping;
+    auto* base = mapRegion (roundUp (numBytes + headerSize, getPageSize()), mapping);
+    *reinterpret_cast<Header*> (base) = { mapping, nullptr };
+    return base + headerSize;
+}
+
+void SampleMemoryArena::release (void* memory) noexcept {
+    if (memory == nullptr) {
+        return;
+    }
+
+    auto* base = static_cast<char*> (memory) - headerSize;
+    auto header = *reinterpret_cast<Header*> (base);
+
+    if (header.chunk == nullptr) {
+        unmapRegion (base, header.mapping);
+        return;
+    }
+
+    const ScopedLock sl (chunkLock);
+    auto& chunk = getChunkHeader (header.chunk);
+
+    // the current chunk stays mapped for the next allocation
+    if (--chunk.numAllocations == 0 && header.chunk != currentChunk) {
+        unmapRegion (header.chunk, chunk.mapping);
+    }
+}
+
+void SampleMemoryArena::setLockingEnabled (bool shouldLock) noexcept {
+    lockingEnabled = shouldLock;
+}
+
+bool SampleMemoryArena::isLockingEnabled() noexcept {
+    return lockingEnabled;
+}
+
+SampleMemoryArena::Stats SampleMemoryArena::getStats() noexcept {
+    Stats stats;
+    stats.residentBytes = residentBytes;
+    stats.hugePageBytes = hugePageBytes;
+    stats.hugePagesRequestedBytes = hugePagesRequestedBytes;
+    stats.lockedBytes = lockedBytes;
+    stats.lockFailures = lockFailures;
+    return stats;
+}
+
+//==============================================================================
+ArenaAudioBuffer::ArenaAudioBuffer (int numChannels, int numSamples) {
+    jassert (numChannels > 0 && numChannels <= 32);
+
+    memory = SampleMemoryArena::allocate ((size_t) numChannels * (size_t) numSamples * sizeof (float));
+
+    float* channels[32];
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        channels[channel] = static_cast<float*> (memory) + (size_t) channel * (size_t) numSamples;
+    }
+
+    buffer.setDataToReferTo (channels, numChannels, numSamples);
+}
+
+ArenaAudioBuffer::~ArenaAudioBuffer() {
+    SampleMemoryArena::release (memory);
+}
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    SampleMemoryArena.h
+    Process-wide allocator for decoded sample data. Small allocations are
+    carved out of shared 2 MB chunks and large ones get a mapping of their
+    own; either way the memory comes from huge pages where the OS offers them
+    (falling back to normal pages), is prefaulted on the thread that maps
+    it - never the audio thread - and can optionally be locked into RAM, so a
+    voice's first read of a freshly loaded sample doesn't take page faults.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class SampleMemoryArena
+{
+public:
+    // Returns zeroed, prefaulted memory of at least numBytes, or throws std::bad_alloc
+    static void* allocate (size_t numBytes);
+    static void release (void* memory) noexcept;
+
+    // Off by default: locked memory is limited on most systems
+    static void setLockingEnabled (bool shouldLock) noexcept;
+    static bool isLockingEnabled() noexcept;
+
+    struct Stats
+    {
+        int64 residentBytes = 0;   // prefaulted and mapped, including the unused rest of each chunk
+        int64 hugePageBytes = 0;   // the part of residentBytes mapped as explicit huge pages
+        // The part we asked to have transparent huge pages. The kernel may still back it with
+        // normal pages (AnonHugePages in /proc/self/smaps shows what it actually did).
+        int64 hugePagesRequestedBytes = 0;
+        int64 lockedBytes = 0;
+        int lockFailures = 0;
+    };
+
+    static Stats getStats() noexcept;
+
+private:
+    SampleMemoryArena() = delete;
+};
+
+//==============================================================================
+// An AudioBuffer whose samples live in the arena. It's sized once and never reallocates.
+class ArenaAudioBuffer
+{
+public:
+    ArenaAudioBuffer (int numChannels, int numSamples);
+    ~ArenaAudioBuffer();
+
+    AudioBuffer<float>& getBuffer() noexcept { return buffer; }
+    const AudioBuffer<float>& getBuffer() const noexcept { return buffer; }
+
+private:
+    void* memory { nullptr };
+    AudioBuffer<float> buffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ArenaAudioBuffer)
+};
@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    SampleRecorder.cpp
+
+  ==============================================================================
+*/
+
+#include "SampleRecorder.h"
+
+//==============================================================================
+SampleRecorder::SampleRecorder() : Thread ("hiSampler recorder") {}
+
+SampleRecorder::~SampleRecorder() {
+    recording = false;
+    stopThread (4000);
+}
+
+void SampleRecorder::prepare (double newSampleRate, int numInputChannels) {
+    if (isThreadRunning()) {
+        stopRecording();
+        waitForThreadToExit (4000);
+    }
+
+    sampleRate = newSampleRate;
+    numChannels = jmin (2, numInputChannels);
+
+    ringBufferSize = jmax (1, (int) (ringBufferSeconds * sampleRate));
+
+    // the ring buffer itself waits for the first take, so instances that never record don't pay for it
+    if (ringBuffer.getNumChannels() != jmax (1, numChannels) || ringBuffer.getNumSamples() != ringBufferSize) {
+        ringBuffer.setSize (0, 0);
+    }
+}
+
+bool SampleRecorder::startRecording() {
+    if (recording) {
+        return true;
+    }
+
+    if (numChannels == 0 || sampleRate <= 0) {
+        return false;
+    }
+
+    // a previous take may still be finishing up
+    waitForThreadToExit (4000);
+
+    // nothing has been pushed since prepare() if it's the wrong size, so it's safe to allocate
+    if (ringBuffer.getNumSamples() != ringBufferSize) {
+        ringBuffer.setSize (jmax (1, numChannels), ringBufferSize);
+        fifo.setTotalSize (ringBufferSize);
+    }
+
+    // anything left over from a block that raced the end of the last take
+    fifo.finishedRead (fifo.getNumReady());
+
+    droppedSamples = 0;
+    recording = true;
+    startThread (5);
+    return true;
+}
+
+void SampleRecorder::stopRecording() {
+    recording = false;
+    notify();
+}
+
+void SampleRecorder::pushInput (const AudioBuffer<float>& input, int numSamples) noexcept {
+    if (! recording || numChannels == 0) {
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        // a mono input feeding a stereo take just gets duplicated
+        auto sourceChannel = jmin (channel, input.getNumChannels() - 1);
+
+        if (size1 > 0) {
+            ringBuffer.copyFrom (channel, start1, input, sourceChannel, 0, size1);
+        }
+
+        if (size2 > 0) {
+            ringBuffer.copyFrom (channel, start2, input, sourceChannel, size1, size2);
+        }
+    }
+
+    fifo.finishedWrite (size1 + size2);
+
+    if (size1 + size2 < numSamples) {
+        droppedSamples += numSamples - (size1 + size2);
+    }
+}
+
+//==============================================================================
+void SampleRecorder::run() {
+    auto file = File::getSpecialLocation (File::userDocumentsDirectory)
+                    .getChildFile ("hiSampler")
+                    .getNonexistentChildFile ("Recording", ".wav");
+    file.getParentDirectory().createDirectory();
+
+    std::unique_ptr<AudioFormatWriter> writer;
+
+    if (auto stream = std::unique_ptr<FileOutputStream> (file.createOutputStream())) {
+        WavAudioFormat wavFormat;
+        writer.reset (wavFormat.createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels, 24, {}, 0));
+
+        if (writer != nullptr) {
+            stream.release(); // the writer owns it now
+        }
+    }
+
+    auto maxTakeLength = jmax (1, (int) (maxTakeSeconds * sampleRate));
+    take.reset (new AudioBuffer<float> (numChannels, maxTakeLength + numPaddingSamples));
+    takeLength = 0;
+
+    while (! threadShouldExit()) {
+        // read the flag before draining, so the last blocks pushed before a stop are kept
+        bool stillRecording = recording;
+        drainRingBuffer (writer.get());
+
+        if (! stillRecording) {
+            break;
+        }
+
+        wait (pollIntervalMs);
+    }
+
+    writer.reset(); // flushes and closes the file
+
+    if (threadShouldExit() || takeLength == 0) {
+        take.reset();
+        return;
+    }
+
+    // silence after the end for the interpolator, then shrink without reallocating
+    take->clear (takeLength, numPaddingSamples);
+    take->setSize (numChannels, takeLength + numPaddingSamples, true, false, true);
+
+    if (onRecordingFinished != nullptr) {
+        Take finished;
+        finished.data = std::move (take);
+        finished.length = takeLength;
+        finished.sampleRate = sampleRate;
+        finished.file = file;
+        onRecordingFinished (std::move (finished));
+    }
+
+    take.reset();
+}
+
+void SampleRecorder::drainRingBuffer (AudioFormatWriter* writer) {
+    auto numReady = fifo.getNumReady();
+
+    if (numReady == 0) {
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (numReady, start1, size1, start2, size2);
+
+    for (auto block : { std::make_pair (start1, size1), std::make_pair (start2, size2) }) {
+        if (block.second <= 0) {
+            continue;
+        }
+
+        // the file keeps everything; the in-memory copy stops once it's full
+        auto numToKeep = jmin (block.second, take->getNumSamples() - numPaddingSamples - takeLength);
+
+        if (numToKeep > 0) {
+            for (int channel = 0; channel < numChannels; ++channel) {
+                take->copyFrom (channel, takeLength, ringBuffer, channel, block.first, numToKeep);
+            }
+
+            takeLength += numToKeep;
+        }
+
+        if (writer != nullptr) {
+            writer->writeFromAudioSampleBuffer (ringBuffer, block.first, block.second);
+        }
+    }
+
+    fifo.finishedRead (size1 + size2);
+}
@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    SampleRecorder.h
+    Captures the sidechain input into a new sample. The audio thread only
+    copies into a preallocated lock-free ring buffer; a background thread
+    drains it, writes the take to disk and hands the finished audio back.
+    The file gets the whole take, however long; the audio handed back keeps
+    the first ten seconds, the same limit as a loaded sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class SampleRecorder : private Thread
+{
+public:
+    SampleRecorder();
+    ~SampleRecorder() override;
+
+    // Called from prepareToPlay. Stops any take in progress; the ring buffer is allocated by the next take.
+    void prepare (double sampleRate, int numInputChannels);
+
+    // Message thread. startRecording returns false if there's no input to record from
+    // or prepare() hasn't been called yet.
+    bool startRecording();
+    void stopRecording();
+    bool isRecording() const noexcept { return recording; }
+
+    // Audio thread: copies the input into the ring buffer. Wait-free and never allocates;
+    // if the writer thread falls behind, the overflow is dropped and counted.
+    void pushInput (const AudioBuffer<float>& input, int numSamples) noexcept;
+
+    int getNumDroppedSamples() const noexcept { return droppedSamples; }
+
+    struct Take
+    {
+        std::unique_ptr<AudioBuffer<float>> data;   // length samples, followed by at least 4 of silence
+        int length = 0;                             // at most maxTakeSeconds; the file has the rest
+        double sampleRate = 0.0;
+        File file;
+    };
+
+    // Called on the recorder thread once a take has been written to disk.
+    std::function<void (Take&&)> onRecordingFinished;
+
+private:
+    void run() override;
+    void drainRingBuffer (AudioFormatWriter* writer);
+
+    static constexpr double ringBufferSeconds = 2.0;
+    static constexpr double maxTakeSeconds = 10.0;
+    static constexpr int pollIntervalMs = 10;
+    static constexpr int numPaddingSamples = 4;
+
+    double sampleRate { 0.0 };
+    int numChannels { 0 };
+
+    AbstractFifo fifo { 1 };
+    AudioBuffer<float> ringBuffer;
+    int ringBufferSize { 0 };
+
+    std::atomic<bool> recording { false };
+    std::atomic<int> droppedSamples { 0 };
+
+    // only touched by the recorder thread while a take is running; the in-memory copy is allocated
+    // whole, so it never grows, and past maxTakeSeconds only the file is written
+    std::unique_ptr<AudioBuffer<float>> take;
+    int takeLength { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleRecorder)
+};
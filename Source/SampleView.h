@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    SampleView.h
+    Non-destructive edits over a sample's data: trim, reverse, gain and
+    normalize. A view never touches the audio itself - voices and the
+    waveform display apply it while reading.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+struct SampleView
+{
+    double start = 0.0;   // trim points, as proportions of the sample length
+    double end = 1.0;
+    bool reversed = false;
+    float gain = 1.0f;
+    bool normalize = false;
+
+    int getStartSample (int length) const noexcept {
+        return jlimit (0, length, roundToInt (jmin (start, end) * length));
+    }
+
+    int getEndSample (int length) const noexcept {
+        return jlimit (getStartSample (length), length, roundToInt (jmax (start, end) * length));
+    }
+
+    // peak is the sample's absolute peak, measured once when it was loaded
+    float getLevel (float peak) const noexcept {
+        return normalize && peak > 0.0f ? gain / peak : gain;
+    }
+
+    bool operator== (const SampleView& other) const noexcept {
+        return start == other.start && end == other.end && reversed == other.reversed
+            && gain == other.gain && normalize == other.normalize;
+    }
+
+    bool operator!= (const SampleView& other) const noexcept { return ! operator== (other); }
+};
@@ -0,0 +1,23 @@
+/*
+  ==============================================================================
+
+    SharedAudioFormatManager.h
+    One AudioFormatManager for the whole process, held through a
+    SharedResourcePointer: the basic formats are registered once, when the
+    first plugin instance opens, rather than by every instance.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Only read from once constructed, so any thread can create readers with it.
+struct SharedAudioFormatManager : public AudioFormatManager
+{
+    SharedAudioFormatManager() { registerBasicFormats(); }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedAudioFormatManager)
+};
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    StartupBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "StartupBenchmark.h"
+
+String StartupBenchmark::Result::toString() const {
+    auto describe = [this] (const String& phase, double totalMs) {
+        return phase + ": " + String (totalMs, 1) + " ms ("
+             + String (totalMs / jmax (1, numInstances), 3) + " ms per instance)" + newLine;
+    };
+
+    return "hiSampler startup, " + String (numInstances) + " instances" + newLine
+         + describe ("  construct", constructMs)
+         + describe ("  prepareToPlay", prepareMs)
+         + describe ("  open editor", editorMs)
+         + describe ("  destroy", destroyMs);
+}
+
+#if HISAMPLER_STARTUP_BENCHMARK
+
+#include "PluginProcessor.h"
+
+//==============================================================================
+StartupBenchmark::Result StartupBenchmark::run (int numInstances, double sampleRate, int blockSize) {
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    Result result;
+    result.numInstances = numInstances;
+
+    std::vector<std::unique_ptr<HiSamplerAudioProcessor>> processors;
+    std::vector<std::unique_ptr<AudioProcessorEditor>> editors;
+    processors.reserve ((size_t) numInstances);
+    editors.reserve ((size_t) numInstances);
+
+    auto start = Time::getMillisecondCounterHiRes();
+
+    for (int i = 0; i < numInstances; ++i) {
+        processors.push_back (std::make_unique<HiSamplerAudioProcessor>());
+    }
+
+    auto constructed = Time::getMillisecondCounterHiRes();
+
+    for (auto& processor : processors) {
+        processor->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor->prepareToPlay (sampleRate, blockSize);
+    }
+
+    auto prepared = Time::getMillisecondCounterHiRes();
+
+    for (auto& processor : processors) {
+        editors.emplace_back (processor->createEditorIfNeeded());
+    }
+
+    auto opened = Time::getMillisecondCounterHiRes();
+
+    // editors first, since they refer to their processors
+    editors.clear();
+
+    for (auto& processor : processors) {
+        processor->releaseResources();
+    }
+
+    processors.clear();
+
+    auto destroyed = Time::getMillisecondCounterHiRes();
+
+    result.constructMs = constructed - start;
+    result.prepareMs = prepared - constructed;
+    result.editorMs = opened - prepared;
+    result.destroyMs = destroyed - opened;
+    return result;
+}
+
+void StartupBenchmark::runOnceAfterStartup() {
+    static std::atomic<bool> hasRun { false };
+
+    if (hasRun.exchange (true)) {
+        return;
+    }
+
+    // after the host has finished creating the instance that got us here
+    MessageManager::callAsync ([] {
+        auto result = run (HISAMPLER_STARTUP_BENCHMARK, 48000.0, 512);
+        Logger::writeToLog (result.toString());
+    });
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  ==============================================================================
+
+    StartupBenchmark.h
+    Measures what opening a project full of hiSampler instances costs: how
+    long N instances take to construct, to prepare, to open their editors
+    and to be destroyed again. Build with HISAMPLER_STARTUP_BENCHMARK=N (e.g.
+    100) and the first instance to open runs it once, on the message thread,
+    and writes the timings to the log. Otherwise everything here compiles
+    away.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef HISAMPLER_STARTUP_BENCHMARK
+ #define HISAMPLER_STARTUP_BENCHMARK 0
+#endif
+
+//==============================================================================
+struct StartupBenchmark
+{
+    struct Result
+    {
+        int numInstances = 0;
+        double constructMs = 0.0, prepareMs = 0.0, editorMs = 0.0, destroyMs = 0.0;   // totals for all instances
+
+        String toString() const;
+    };
+
+   #if HISAMPLER_STARTUP_BENCHMARK
+    // Message thread: creates, prepares and opens the editors of numInstances processors
+    static Result run (int numInstances, double sampleRate, int blockSize);
+
+    // Called by every new processor; only the first one schedules a run
+    static void runOnceAfterStartup();
+   #else
+    static void runOnceAfterStartup() {}
+   #endif
+};